@@ -3,17 +3,22 @@
 #include <QDebug>
 #include <QSet>
 #include <QFileInfo>
+#include <QDir>
 #include <QPainterPath>
-#include <QBuffer>
 #include <QFileInfo>
 #include <QGuiApplication>
 #include <QClipboard>
 #include <QPair>
-#include <stack>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cstring>
 #include <cmath>
 #include <math.h>
 
 #include "mainwindow.h"
+#include "pixelkernels.h"
+#include "canvasfile.h"
+#include "floodfill.h"
 
 //Todo outer stroke. square and round edges option. thickness option.
 //Todo custom brush shape.
@@ -26,28 +31,24 @@ namespace Constants
 
 //Colors
 const QColor ImageBorderColor = QColor(200,200,200,255);
-const QColor TransparentGrey = QColor(190,190,190,255);
-const QColor TransparentWhite = QColor(255,255,255,255);
 const QColor SelectionBorderColor = Qt::blue;
 const QColor SelectionAreaColor = QColor(0,40,100,50);
 const int MinRgbValue = 0;
 const int MaxRgbValue = 255;
-const int MiddleRgbValue = 127;
-const int MaxSaturation = 255;
-const int MinSaturation = 0;
-const int MaxHue = 179;
-const int MinHue = 0;
 
 //Drawing
 const int SelectedPixelsOutlineFlashFrequency = 200;
 
+//Effects
+const int EffectApplyProgressDelay = 500;//ms before the progress dialog shows
+const QString EffectApplyProgressText = "Applying effect...";
+
 //History-undo-redo
-const uint MaxCanvasHistory = 20;
+const qint64 CanvasHistoryMemoryBudget = qint64(512) * 1024 * 1024;
 
 //Saving/loading
 const QString CanvasSaveFileType = "paintProgram";
-const QString CanvasSaveLayerBegin = "BEGIN_LAYER";
-const QString CanvasSaveLayerEnd = "END_LAYER";
+const QString AutosaveFileTag = "_autosave";
 
 //Zooming
 const float ZoomIncrement = 1.1;
@@ -57,22 +58,24 @@ const float ZoomPanFactor = 0.1;
 const int DragNubbleSize = 8;
 }
 
-QImage genTransparentPixelsBackground(const int width, const int height)
+//Area of the widget showing canvasRect (in canvas pixels) at zoomFactor & pan offset. Grown by a pixel to cover antialiased edges.
+QRect getCanvasRectOnWidget(const QRect& canvasRect, const QPoint& center, const float& zoomFactor, const int& offsetX, const int& offsetY)
 {
-    // ~ Test if quicker to paint all white, then fill grey squares after
-    QImage transparentBackground = QImage(QSize(width, height), QImage::Format_ARGB32);
-    for(int x = 0; x < width; x++)
-    {
-        for(int y = 0; y < height; y++)
-        {
-            const QColor col = (x % 2 == 0) ?
-                        (y % 2 == 0) ? Constants::TransparentWhite : Constants::TransparentGrey
-                                     :
-                        (y % 2 == 0) ? Constants::TransparentGrey : Constants::TransparentWhite;
-            transparentBackground.setPixelColor(x, y, col);
-        }
-    }
-    return transparentBackground;
+    QTransform transform;
+    transform.translate(center.x(), center.y());
+    transform.scale(zoomFactor, zoomFactor);
+    transform.translate(-center.x(), -center.y());
+    return transform.mapRect(QRectF(canvasRect.translated(offsetX, offsetY))).toAlignedRect().adjusted(-1, -1, 1, 1);
+}
+
+//Area of the canvas (in canvas pixels) shown in widgetRect. Inverse of getCanvasRectOnWidget.
+QRect getWidgetRectOnCanvas(const QRect& widgetRect, const QPoint& center, const float& zoomFactor, const int& offsetX, const int& offsetY)
+{
+    QTransform transform;
+    transform.translate(center.x(), center.y());
+    transform.scale(zoomFactor, zoomFactor);
+    transform.translate(-center.x(), -center.y());
+    return transform.inverted().mapRect(QRectF(widgetRect)).toAlignedRect().translated(-offsetX, -offsetY).adjusted(-1, -1, 1, 1);
 }
 
 QList<CanvasLayerInfo> getLayerInfoList(QList<CanvasLayer>& canvasLayers)
@@ -85,6 +88,27 @@ QList<CanvasLayerInfo> getLayerInfoList(QList<CanvasLayer>& canvasLayers)
     return layers;
 }
 
+//Joins tiled history layers back into canvas layers. Disabled layers are left undecoded.
+QList<CanvasLayer> getCanvasLayers(const QList<TiledCanvasLayer>& tiledLayers)
+{
+    QList<CanvasLayer> layers;
+    for(const TiledCanvasLayer& tiledLayer : tiledLayers)
+    {
+        CanvasLayer layer;
+        layer.m_info = tiledLayer.m_info;
+        if(tiledLayer.m_info.m_enabled)
+        {
+            layer.m_image = tiledLayer.m_image.toImage();
+        }
+        else
+        {
+            layer.m_undecodedImage = tiledLayer.m_image;
+        }
+        layers.push_back(layer);
+    }
+    return layers;
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /// Canvas
@@ -105,37 +129,23 @@ Canvas::Canvas(MainWindow *parent, QString& filePath, bool& loadSuccess) :
     QTabWidget(),
     m_pParent(parent)
 {
+    bool fileLoaded = true;
     if(QFileInfo(filePath).suffix().contains(Constants::CanvasSaveFileType))
     {
-        QFile inFile(filePath);
-        inFile.open(QIODevice::ReadOnly | QIODevice::Text);
-        QTextStream in(&inFile);
-
-        while(!in.atEnd())
+        fileLoaded = CanvasFile::load(filePath, m_canvasLayers);
+        if(fileLoaded)
         {
-            QString line = in.readLine();
-            if(line == Constants::CanvasSaveLayerBegin)
+            //Only decode the layers needed to show the canvas, the rest are decoded when first used
+            for(int i = 0; i < m_canvasLayers.size(); i++)
             {
-                CanvasLayer cl;
-
-                //Read layer info
-                cl.m_info.m_name = in.readLine();
-                cl.m_info.m_enabled = in.readLine() == "1" ? true : false;
-
-                //Read layer image data
-                QByteArray ba;
-                QTextStream(&ba) << in.readLine();
-                QByteArray layerImageData = QByteArray::fromHex(ba);
-                cl.m_image.loadFromData(layerImageData);
-
-                if(cl.m_image != QImage() && !cl.m_image.isNull())
+                if(i == 0 || m_canvasLayers[i].m_info.m_enabled)
                 {
-                    m_canvasLayers.push_back(cl);
+                    decodeLayer(i);
                 }
             }
-        }
 
-        m_savePath = filePath;
+            m_savePath = filePath;
+        }
     }
     else
     {
@@ -150,7 +160,7 @@ Canvas::Canvas(MainWindow *parent, QString& filePath, bool& loadSuccess) :
     }
 
     //Did we load successfully?
-    if(m_canvasLayers.size() == 0)
+    if(!fileLoaded || m_canvasLayers.size() == 0)
     {
         loadSuccess = false;
         qDebug() << "Canvas::Canvas - Failed to load canvas!";
@@ -170,15 +180,23 @@ void Canvas::init(uint width, uint height)
     m_canvasWidth = width;
     m_canvasHeight = height;
 
-    m_canvasBackgroundImage = genTransparentPixelsBackground(m_canvasWidth, m_canvasHeight);
-
     m_selectionTool = new QRubberBand(QRubberBand::Rectangle, this);
     m_selectionTool->setGeometry(QRect(m_selectionToolOrigin, QSize()));
 
     m_pClipboardPixels = new PaintableClipboard(this, m_canvasWidth, m_canvasHeight);
     m_pClipboardPixels->raise();
 
-    m_canvasHistory.recordHistory(getSnapshot());
+    m_pSaveWatcher = new QFutureWatcher<bool>(this);
+    connect(m_pSaveWatcher, SIGNAL(finished()), this, SLOT(onSaveFinished()));
+
+    m_pLayerEffectWatcher = new QFutureWatcher<QImage>(this);
+    connect(m_pLayerEffectWatcher, SIGNAL(finished()), this, SLOT(onLayerEffectApplied()));
+
+    m_pEffectPreviewScheduler = new EffectScheduler(this);
+    connect(m_pEffectPreviewScheduler, SIGNAL(frameReady(const quint64, const QImage)), this, SLOT(onEffectPreviewReady(const quint64, const QImage)));
+
+    recordHistory();
+    m_savedChangeCount = m_changeCount;
 
     setMouseTracking(true);
 }
@@ -255,65 +273,146 @@ QString Canvas::getSavePath()
     return m_savePath;
 }
 
-bool Canvas::save(QString path)
+void Canvas::save(QString path)
 {
-    m_savePath = path;
+    waitForLayerEffect();
 
-    QFile file(path);
-    file.open(QIODevice::WriteOnly | QIODevice::Text);
-    QTextStream out(&file);
+    startSave(path, false);
+}
 
-    for(CanvasLayer& cl : m_canvasLayers)
+void Canvas::autosave()
+{
+    waitForLayerEffect();
+
+    if(m_changeCount == m_savedChangeCount || m_savePath == "")
     {
-        out << Constants::CanvasSaveLayerBegin << "\n";;
-        out << cl.m_info.m_name << "\n";
-        out << cl.m_info.m_enabled << "\n";;
+        return;
+    }
 
-        QByteArray ba;
-        QBuffer buffer(&ba);
-        buffer.open(QIODevice::WriteOnly);
+    startSave(getAutosavePath(), true);
+}
 
-        cl.m_image.save(&buffer, "PNG");
-        out << buffer.data().toHex() << "\n";
-        out << Constants::CanvasSaveLayerEnd << "\n";
+QString Canvas::getAutosavePath()
+{
+    //Next to the save, with the .paintProgram suffix so it can be opened like any other save
+    const QFileInfo saveFileInfo(m_savePath);
+    return saveFileInfo.dir().filePath(saveFileInfo.completeBaseName() + Constants::AutosaveFileTag + "." + Constants::CanvasSaveFileType);
+}
+
+void Canvas::startSave(const QString& path, const bool& bAutosave)
+{
+    //One save at a time, so two writes of the same file never overlap
+    if(m_pSaveWatcher->isRunning())
+    {
+        const QPair<QString, bool> pendingSave = qMakePair(path, bAutosave);
+        if(!m_pendingSaves.contains(pendingSave))
+        {
+            m_pendingSaves.push_back(pendingSave);
+        }
+        return;
     }
 
-    file.close();
-    return true;
+    //Layer images are implicitly shared, so this copy is cheap. Painting afterwards detaches the canvas's
+    //  images, leaving the worker thread with the layers as they are now.
+    const QList<CanvasLayer> layers = m_canvasLayers;
+
+    //Decoded layers usually already have tiles from recording history - those are written instead of tiling again
+    QList<TiledLayerCacheItem> cachedTiles;
+    for(const CanvasLayer& layer : layers)
+    {
+        cachedTiles.push_back(layer.m_image.isNull() ? TiledLayerCacheItem() : m_tiledLayerCache.value(layer.m_image.cacheKey()));
+    }
+
+    m_currentSavePath = path;
+    m_bCurrentSaveIsAutosave = bAutosave;
+    m_currentSaveChangeCount = m_changeCount;
+    m_pSaveWatcher->setFuture(QtConcurrent::run([path, layers, cachedTiles]()-> bool
+    {
+        QList<TiledImage> layerTiles;
+        for(int i = 0; i < layers.size(); i++)
+        {
+            const TiledLayerCacheItem& cached = cachedTiles[i];
+            layerTiles.push_back(cached.m_tiles.isNull() || cached.m_editedRect.isEmpty() ? cached.m_tiles :
+                                    TiledImage::fromImage(layers[i].m_image, cached.m_tiles, cached.m_editedRect));
+        }
+        return CanvasFile::save(path, layers, layerTiles);
+    }));
+}
+
+void Canvas::onSaveFinished()
+{
+    const bool success = m_pSaveWatcher->result();
+
+    //Only once the file is written - a failed save leaves the old save path & keeps the changes due an autosave.
+    //  Changes made while writing weren't in the snapshot, so are still unsaved.
+    if(success)
+    {
+        m_savedChangeCount = m_currentSaveChangeCount;
+        if(!m_bCurrentSaveIsAutosave)
+        {
+            m_savePath = m_currentSavePath;
+        }
+    }
+
+    emit saveFinished(m_currentSavePath, success);
+
+    //Pending saves snapshot the layers now, so they include everything changed while the last save was written
+    if(!m_pendingSaves.isEmpty())
+    {
+        const QPair<QString, bool> pendingSave = m_pendingSaves.takeFirst();
+        startSave(pendingSave.first, pendingSave.second);
+    }
 }
 
 void Canvas::onLayerAdded()
 {
+    waitForLayerEffect();
+
     CanvasLayer canvasLayer;
     canvasLayer.m_image = QImage(QSize(m_canvasWidth, m_canvasHeight), QImage::Format_ARGB32);
     canvasLayer.m_image.fill(Qt::transparent);
     m_canvasLayers.push_back(canvasLayer);
 
-    m_canvasHistory.recordHistory(getSnapshot());
+    recordHistory();
 }
 
 void Canvas::onLayerDeleted(const uint index)
 {
+    waitForLayerEffect();
+
     m_canvasLayers.removeAt(index);
-    m_canvasHistory.recordHistory(getSnapshot());
+    decodeLayer(m_selectedLayer);
+    recordHistory();
 }
 
 void Canvas::onLayerEnabledChanged(const uint index, const bool enabled)
 {
+    waitForLayerEffect();
+
     m_canvasLayers[index].m_info.m_enabled = enabled; //Assumes there is a layer at index
-    m_canvasHistory.recordHistory(getSnapshot());
+    if(enabled)
+    {
+        decodeLayer(index);
+    }
+    recordHistory();
 }
 
 void Canvas::onLayerTextChanged(const uint index, QString text)
 {
+    waitForLayerEffect();
+
     m_canvasLayers[index].m_info.m_name = text; //Assumes there is a layer at index
-    m_canvasHistory.recordHistory(getSnapshot());
+    recordHistory();
 }
 
 void Canvas::onLayerMergeRequested(const uint layerIndexA, const uint layerIndexB)
 {
+    waitForLayerEffect();
+
     if(layerIndexA < (uint)m_canvasLayers.count() && layerIndexB < (uint)m_canvasLayers.count() && m_selectedLayer == layerIndexA)
     {
+        decodeLayer(layerIndexB);
+
         //Paint layer b onto layer a
         QPainter mergePainter(&m_canvasLayers[layerIndexA].m_image);
         mergePainter.setCompositionMode (QPainter::CompositionMode_SourceAtop);
@@ -329,7 +428,7 @@ void Canvas::onLayerMergeRequested(const uint layerIndexA, const uint layerIndex
         //Update layer dialog on new layers
         m_pParent->setLayers(getLayerInfoList(m_canvasLayers), m_selectedLayer);
 
-        m_canvasHistory.recordHistory(getSnapshot());
+        recordHistory();
 
         update();
     }
@@ -341,16 +440,19 @@ void Canvas::onLayerMergeRequested(const uint layerIndexA, const uint layerIndex
 
 void Canvas::onLayerMoveUp(const uint index)
 {
+    waitForLayerEffect();
+
     if(index > 0 && (int)index < m_canvasLayers.size())
     {
         //Move up
         m_canvasLayers.swapItemsAt(index, index - 1);
         m_selectedLayer = index - 1;
+        decodeLayer(m_selectedLayer);
 
         //Update layer dialog on new layers
         m_pParent->setLayers(getLayerInfoList(m_canvasLayers), m_selectedLayer);
 
-        m_canvasHistory.recordHistory(getSnapshot());
+        recordHistory();
 
         update();
     }
@@ -362,16 +464,19 @@ void Canvas::onLayerMoveUp(const uint index)
 
 void Canvas::onLayerMoveDown(const uint index)
 {
+    waitForLayerEffect();
+
     if((int)index < m_canvasLayers.size() - 1)
     {
         //Move down
         m_canvasLayers.swapItemsAt(index + 1, index);
         m_selectedLayer = index + 1;
+        decodeLayer(m_selectedLayer);
 
         //Update layer dialog on new layers
         m_pParent->setLayers(getLayerInfoList(m_canvasLayers), m_selectedLayer);
 
-        m_canvasHistory.recordHistory(getSnapshot());
+        recordHistory();
 
         update();
     }
@@ -383,6 +488,8 @@ void Canvas::onLayerMoveDown(const uint index)
 
 void Canvas::onSelectedLayerChanged(const uint index)
 {
+    waitForLayerEffect();
+
     //Reset effects incase in the middle of effects when switched layer
     if(m_beforeEffectsImage != QImage() || m_beforeEffectsClipboard.m_clipboardImage != QImage())
     {
@@ -390,10 +497,13 @@ void Canvas::onSelectedLayerChanged(const uint index)
     }
 
     m_selectedLayer = index;
+    decodeLayer(m_selectedLayer);
 }
 
 void Canvas::onLoadLayer(CanvasLayer canvasLayer)
 {
+    waitForLayerEffect();
+
     //Take canvasLayer's image and map it to an image with m_canvasWidth, m_canvasHeight dimensions
     QImage newLayerImage = QImage(QSize(m_canvasWidth, m_canvasHeight), QImage::Format_ARGB32);
     newLayerImage.fill(Qt::transparent);
@@ -410,16 +520,23 @@ void Canvas::onLoadLayer(CanvasLayer canvasLayer)
     //Update layers dlg
     m_pParent->setLayers(getLayerInfoList(m_canvasLayers), m_selectedLayer);
 
-    m_canvasHistory.recordHistory(getSnapshot());
+    recordHistory();
 }
 
 void Canvas::onUpdateSettings(int width, int height, QString name)
 {
+    waitForLayerEffect();
+
     m_canvasWidth = width;
     m_canvasHeight = height;
 
     m_pClipboardPixels->updateParentCanvasSize(m_canvasWidth, m_canvasHeight);
 
+    for(int i = 0; i < m_canvasLayers.size(); i++)
+    {
+        decodeLayer(i);
+    }
+
     for(CanvasLayer& canvasLayer : m_canvasLayers)
     {
         //Create new image based on new settings
@@ -436,8 +553,6 @@ void Canvas::onUpdateSettings(int width, int height, QString name)
         canvasLayer.m_image = newImage;
     }
 
-    m_canvasBackgroundImage = genTransparentPixelsBackground(width, height);
-
     emit canvasSizeChange(width, height);
 
     if(m_savePath != "")
@@ -458,10 +573,12 @@ void Canvas::onCurrentToolUpdated(const Tool t)
 
 void Canvas::onDeleteKeyPressed()
 {
+    waitForLayerEffect();
+
     if(m_pClipboardPixels->clipboardActive())
     {
         m_pClipboardPixels->reset();
-        m_canvasHistory.recordHistory(getSnapshot());
+        recordHistory();
     }
     else if(m_pClipboardPixels->containsPixels())
     {
@@ -472,7 +589,7 @@ void Canvas::onDeleteKeyPressed()
 
         m_pClipboardPixels->reset();
 
-        m_canvasHistory.recordHistory(getSnapshot());
+        recordHistory();
 
         update();
     }
@@ -480,6 +597,8 @@ void Canvas::onDeleteKeyPressed()
 
 void Canvas::onCopyKeysPressed()
 {
+    waitForLayerEffect();
+
     //IF were dragging
     if(m_pClipboardPixels->clipboardActive())
     {
@@ -503,6 +622,8 @@ void Canvas::onCopyKeysPressed()
 
 void Canvas::onCutKeysPressed()
 {
+    waitForLayerEffect();
+
     QImage clipboardImage;
 
     //What if already dragging something around?
@@ -513,7 +634,7 @@ void Canvas::onCutKeysPressed()
         //Reset
         m_pClipboardPixels->reset();
 
-        m_canvasHistory.recordHistory(getSnapshot());
+        recordHistory();
     }
     else
     {
@@ -533,7 +654,7 @@ void Canvas::onCutKeysPressed()
             //Reset
             m_pClipboardPixels->reset();
 
-            m_canvasHistory.recordHistory(getSnapshot());
+            recordHistory();
         }
     }
 
@@ -544,6 +665,8 @@ void Canvas::onCutKeysPressed()
 
 void Canvas::onPasteKeysPressed()
 {
+    waitForLayerEffect();
+
     if(m_pClipboardPixels->clipboardActive())
     {
         //Dump clipboard
@@ -555,15 +678,20 @@ void Canvas::onPasteKeysPressed()
     QImage clipboardImage = QGuiApplication::clipboard()->image();
     m_pClipboardPixels->setImage(clipboardImage);
 
-    m_canvasHistory.recordHistory(getSnapshot());
+    recordHistory();
 }
 
 void Canvas::onUndoPressed()
 {
+    waitForLayerEffect();
+
     CanvasHistoryItem snapShot;
     if(m_canvasHistory.undoHistory(snapShot))
     {
-        m_canvasLayers = snapShot.m_layers;
+        m_changeCount++;
+
+        m_canvasLayers = getCanvasLayers(snapShot.m_layers);
+        cacheTiledLayers(snapShot);
         m_pClipboardPixels->setClipboard(snapShot.m_clipboard);
 
         //Incase m_selectedLayer is now out of bounds due to m_canvasLayers changing
@@ -571,6 +699,7 @@ void Canvas::onUndoPressed()
         {
             m_selectedLayer = m_canvasLayers.size() - 1; //assumes theres at least one layer - which there always is
         }
+        decodeLayer(m_selectedLayer);
 
         m_pParent->setLayers(getLayerInfoList(m_canvasLayers), m_selectedLayer);
 
@@ -580,11 +709,17 @@ void Canvas::onUndoPressed()
 
 void Canvas::onRedoPressed()
 {
+    waitForLayerEffect();
+
     CanvasHistoryItem snapShot;
     if(m_canvasHistory.redoHistory(snapShot))
     {
-        m_canvasLayers = snapShot.m_layers;
+        m_changeCount++;
+
+        m_canvasLayers = getCanvasLayers(snapShot.m_layers);
+        cacheTiledLayers(snapShot);
         m_pClipboardPixels->setClipboard(snapShot.m_clipboard);
+        decodeLayer(m_selectedLayer);
 
         m_pParent->setLayers(getLayerInfoList(m_canvasLayers), m_selectedLayer);
 
@@ -592,88 +727,64 @@ void Canvas::onRedoPressed()
     }
 }
 
-void operateOnCanvasPixels(QImage& canvas, std::function<void (int, int)> func)
+void Canvas::onBlackAndWhite()
 {
-    for(int x = 0; x < canvas.width(); x++)
+    const auto greyScaleKernel = [](const QRgb col)-> QRgb
     {
-        for(int y = 0; y < canvas.height(); y++)
-        {
-            func(x, y);
-        }
-    }
-}
+        return PixelKernels::greyScaleColor(col);
+    };
 
-QColor greyScaleColor(const QColor col)
-{
-    const int grey = (col.red() + col.green() + col.blue())/3;
-    return QColor(grey, grey, grey, col.alpha());
-}
-
-void Canvas::onBlackAndWhite()
-{
     //check if were doing the whole image or just some selected pixels
     if(m_pClipboardPixels->clipboardActive())
     {
         //Loop through selected pixels
-        m_pClipboardPixels->operateOnSelectedPixels([&](int x, int y)-> void
-        {
-            m_pClipboardPixels->m_clipboardImage.setPixelColor(x, y, greyScaleColor(m_pClipboardPixels->m_clipboardImage.pixelColor(x,y)));
-        });
+        PixelKernels::operateOnPixels(m_pClipboardPixels->m_clipboardImage, m_pClipboardPixels->getPixels(), greyScaleKernel);
     }
     else if(m_pClipboardPixels->containsPixels())
     {
         //Loop through selected pixels, turning to white&black
-        m_pClipboardPixels->operateOnSelectedPixels([&](int x, int y)-> void
-        {
-            m_canvasLayers[m_selectedLayer].m_image.setPixelColor(x, y, greyScaleColor(m_canvasLayers[m_selectedLayer].m_image.pixelColor(x, y)));
-        });
+        PixelKernels::operateOnPixels(m_canvasLayers[m_selectedLayer].m_image, m_pClipboardPixels->getPixels(), greyScaleKernel);
     }
     else
     {
-        operateOnCanvasPixels(m_canvasLayers[m_selectedLayer].m_image, [&](int x, int y)-> void
+        PixelKernels::operateOnScanlinesConcurrent(m_canvasLayers[m_selectedLayer].m_image, [](QRgb* line, const int, const int width)-> void
         {
-            m_canvasLayers[m_selectedLayer].m_image.setPixelColor(x, y, greyScaleColor(m_canvasLayers[m_selectedLayer].m_image.pixelColor(x, y))); //Assumes there is a selected layer
-        });
+            PixelKernels::greyScale(line, width);
+        }); //Assumes there is a selected layer
     }
 
-    m_canvasHistory.recordHistory(getSnapshot());
+    recordHistory();
 
     update();
 }
 
-QColor invertColor(const QColor col)
-{
-    return QColor(Constants::MaxRgbValue - col.red(), Constants::MaxRgbValue - col.green(), Constants::MaxRgbValue - col.blue(), col.alpha());
-}
-
 void Canvas::onInvert() // todo make option to invert alpha aswell
 {
+    const auto invertKernel = [](const QRgb col)-> QRgb
+    {
+        return PixelKernels::invertColor(col);
+    };
+
     //check if were doing the whole image or just some selected pixels
     if(m_pClipboardPixels->clipboardActive())
     {
         //Loop through selected pixels
-        m_pClipboardPixels->operateOnSelectedPixels([&](int x, int y)-> void
-        {
-            m_pClipboardPixels->m_clipboardImage.setPixelColor(x, y, invertColor(m_pClipboardPixels->m_clipboardImage.pixelColor(x,y)));
-        });
+        PixelKernels::operateOnPixels(m_pClipboardPixels->m_clipboardImage, m_pClipboardPixels->getPixels(), invertKernel);
     }
     else if(m_pClipboardPixels->containsPixels())
     {
         //Loop through selected pixels
-        m_pClipboardPixels->operateOnSelectedPixels([&](int x, int y)-> void
-        {
-            m_canvasLayers[m_selectedLayer].m_image.setPixelColor(x, y, invertColor(m_canvasLayers[m_selectedLayer].m_image.pixelColor(x,y)));
-        });
+        PixelKernels::operateOnPixels(m_canvasLayers[m_selectedLayer].m_image, m_pClipboardPixels->getPixels(), invertKernel);
     }
     else
     {
-        operateOnCanvasPixels(m_canvasLayers[m_selectedLayer].m_image, [&](int x, int y)-> void
+        PixelKernels::operateOnScanlinesConcurrent(m_canvasLayers[m_selectedLayer].m_image, [](QRgb* line, const int, const int width)-> void
         {
-            m_canvasLayers[m_selectedLayer].m_image.setPixelColor(x, y, invertColor(m_canvasLayers[m_selectedLayer].m_image.pixelColor(x,y)));
+            PixelKernels::invert(line, width);
         });
     }
 
-    m_canvasHistory.recordHistory(getSnapshot());
+    recordHistory();
 
     update();
 }
@@ -698,29 +809,69 @@ bool compareNeighbour(QImage& image, const int x, const int y, const int neighbo
     return false;
 }
 
-bool checkCreateSketchOnPixel(QImage& original, QImage& sketch, const int& x, const int& y, const QColor sketchColor, const int& sensitivity)
+//sketch covers original from sketchOrigin, so sketches of selected pixels only need to be the size of the selection
+bool checkCreateSketchOnPixel(QImage& original, QImage& sketch, const QPoint& sketchOrigin, const int& x, const int& y, const QColor sketchColor, const int& sensitivity)
 {
-    if(compareNeighbour(original, x, y, x+1, y, sensitivity))
+    if(compareNeighbour(original, x, y, x+1, y, sensitivity) ||
+       compareNeighbour(original, x, y, x-1, y, sensitivity) ||
+       compareNeighbour(original, x, y, x, y+1, sensitivity) ||
+       compareNeighbour(original, x, y, x, y-1, sensitivity))
     {
-        sketch.setPixelColor(x, y, sketchColor);
-    }
-    else if(compareNeighbour(original, x, y, x-1, y, sensitivity))
-    {
-        sketch.setPixelColor(x, y, sketchColor);
-    }
-    else if(compareNeighbour(original, x, y, x, y+1, sensitivity))
-    {
-        sketch.setPixelColor(x, y, sketchColor);
-    }
-    else if(compareNeighbour(original, x, y, x, y-1, sensitivity))
-    {
-        sketch.setPixelColor(x, y, sketchColor);
+        sketch.setPixelColor(x - sketchOrigin.x(), y - sketchOrigin.y(), sketchColor);
+        return true;
     }
-    else
+    return false;
+}
+
+//Same check as compareNeighbour, on raw colors
+inline bool isDifferentColor(const QRgb pixelColor, const QRgb neighbourPixel, const int sensitivity)
+{
+    return qAbs(qRed(pixelColor) - qRed(neighbourPixel)) >= sensitivity ||
+           qAbs(qGreen(pixelColor) - qGreen(neighbourPixel)) >= sensitivity ||
+           qAbs(qBlue(pixelColor) - qBlue(neighbourPixel)) >= sensitivity ||
+           qAbs(qAlpha(pixelColor) - qAlpha(neighbourPixel)) >= sensitivity;
+}
+
+//Whole image version of checkCreateSketchOnPixel. Rows are done concurrently.
+//  original is only read, sketch gets sketchColor on every pixel that differs from a neighbour.
+void createSketchOnImage(const QImage& originalImage, QImage& sketch, const QColor sketchColor, const int& sensitivity)
+{
+    //What pixelColor gives for neighbours off the edge of the image (invalid color - black, full alpha)
+    const QRgb offImageColor = qRgba(0, 0, 0, 255);
+
+    const QImage original = PixelKernels::toArgb32(originalImage);
+    PixelKernels::ensureArgb32(sketch);
+
+    const int width = original.width();
+    const int height = original.height();
+    const QRgb sketchRgb = sketchColor.rgba();
+    const uchar* originalBits = original.constBits();
+    const qsizetype originalBytesPerLine = original.bytesPerLine();
+    uchar* sketchBits = sketch.bits();
+    const qsizetype sketchBytesPerLine = sketch.bytesPerLine();
+
+    PixelKernels::operateOnRowBandsConcurrent(width, height, [&](const int firstRow, const int endRow)-> void
     {
-        return false;
-    }
-    return true;
+        for(int y = firstRow; y < endRow; y++)
+        {
+            const QRgb* line = reinterpret_cast<const QRgb*>(originalBits + y * originalBytesPerLine);
+            const QRgb* lineAbove = y > 0 ? reinterpret_cast<const QRgb*>(originalBits + (y - 1) * originalBytesPerLine) : nullptr;
+            const QRgb* lineBelow = y + 1 < height ? reinterpret_cast<const QRgb*>(originalBits + (y + 1) * originalBytesPerLine) : nullptr;
+            QRgb* sketchLine = reinterpret_cast<QRgb*>(sketchBits + y * sketchBytesPerLine);
+
+            for(int x = 0; x < width; x++)
+            {
+                const QRgb pixel = line[x];
+                if(isDifferentColor(pixel, x + 1 < width ? line[x + 1] : offImageColor, sensitivity) ||
+                   isDifferentColor(pixel, x > 0 ? line[x - 1] : offImageColor, sensitivity) ||
+                   isDifferentColor(pixel, lineBelow ? lineBelow[x] : offImageColor, sensitivity) ||
+                   isDifferentColor(pixel, lineAbove ? lineAbove[x] : offImageColor, sensitivity))
+                {
+                    sketchLine[x] = sketchRgb;
+                }
+            }
+        }
+    });
 }
 
 void Canvas::onSketchEffect(const int sensitivity)
@@ -731,7 +882,6 @@ void Canvas::onSketchEffect(const int sensitivity)
         return;
     }
 
-    QImage inkSketch = QImage(QSize(m_canvasLayers[m_selectedLayer].m_image.width(), m_canvasLayers[m_selectedLayer].m_image.height()), QImage::Format_ARGB32);
     const QColor sketchColor = m_pParent->getSelectedColor() != Qt::white ? m_pParent->getSelectedColor() : Qt::black;
 
     //check if were doing the whole image or just some selected pixels
@@ -739,52 +889,56 @@ void Canvas::onSketchEffect(const int sensitivity)
     {
         m_pClipboardPixels->setClipboard(getClipboardBeforeEffects());
 
+        const QRect selectedRect = m_pClipboardPixels->m_pixels.boundingRect();
+        QImage inkSketch = QImage(selectedRect.size(), QImage::Format_ARGB32);
         inkSketch.fill(Qt::transparent);
 
         //Loop through selected pixels
         m_pClipboardPixels->operateOnSelectedPixels([&](int x, int y)-> void
-        {            
-            if(!checkCreateSketchOnPixel(m_pClipboardPixels->m_clipboardImage, inkSketch, x, y, sketchColor, sensitivity))
+        {
+            if(!checkCreateSketchOnPixel(m_pClipboardPixels->m_clipboardImage, inkSketch, selectedRect.topLeft(), x, y, sketchColor, sensitivity))
             {
-                inkSketch.setPixelColor(x, y, Qt::white);
+                inkSketch.setPixelColor(x - selectedRect.left(), y - selectedRect.top(), Qt::white);
             }
         });
 
         QPainter sketchPainter(&m_pClipboardPixels->m_clipboardImage);
-        sketchPainter.drawImage(0,0,inkSketch);
+        sketchPainter.drawImage(selectedRect.topLeft(), inkSketch);
     }
     else if(m_pClipboardPixels->containsPixels())
     {
         //Get backup of canvas image before effects were applied (create backup if first effect)
         m_canvasLayers[m_selectedLayer].m_image = getCanvasImageBeforeEffects(); //Assumes there is a selected layer
 
+        const QRect selectedRect = m_pClipboardPixels->m_pixels.boundingRect();
+        QImage inkSketch = QImage(selectedRect.size(), QImage::Format_ARGB32);
         inkSketch.fill(Qt::transparent);
 
         //Loop through selected pixels
         m_pClipboardPixels->operateOnSelectedPixels([&](int x, int y)-> void
         {
-            if(!checkCreateSketchOnPixel(m_canvasLayers[m_selectedLayer].m_image, inkSketch, x, y, sketchColor, sensitivity))
+            if(!checkCreateSketchOnPixel(m_canvasLayers[m_selectedLayer].m_image, inkSketch, selectedRect.topLeft(), x, y, sketchColor, sensitivity))
             {
-                inkSketch.setPixelColor(x, y, Qt::white);
+                inkSketch.setPixelColor(x - selectedRect.left(), y - selectedRect.top(), Qt::white);
             }
         });
 
         QPainter sketchPainter(&m_canvasLayers[m_selectedLayer].m_image);
-        sketchPainter.drawImage(0,0,inkSketch);
+        sketchPainter.drawImage(selectedRect.topLeft(), inkSketch);
     }
     else
     {
-        //Get backup of canvas image before effects were applied (create backup if first effect)
-        m_canvasLayers[m_selectedLayer].m_image = getCanvasImageBeforeEffects(); //Assumes there is a selected layer
-
-        inkSketch.fill(Qt::white);
-
-        operateOnCanvasPixels(m_canvasLayers[m_selectedLayer].m_image, [&](int x, int y)-> void
+        //Reads the pixels next to each pixel
+        previewLayerEffect([sketchColor, sensitivity](const QImage& beforeEffects)-> QImage
         {
-            checkCreateSketchOnPixel(m_canvasLayers[m_selectedLayer].m_image, inkSketch, x, y, sketchColor, sensitivity);
-        });
+            QImage image = beforeEffects;
+            QImage inkSketch = QImage(image.size(), QImage::Format_ARGB32);
+            inkSketch.fill(Qt::white);
+
+            createSketchOnImage(image, inkSketch, sketchColor, sensitivity);
 
-        m_canvasLayers[m_selectedLayer].m_image = inkSketch;
+            return inkSketch;
+        }, 1);
     }
 
     //Record history is done in onConfirmEffects()
@@ -792,18 +946,6 @@ void Canvas::onSketchEffect(const int sensitivity)
     update();
 }
 
-QVector<QVector<bool>> listTo2dVector(const QVector<QPoint>& selectedPixels, const int& width, const int& height)
-{
-     QVector<QVector<bool>> selectedPixelsVector = QVector<QVector<bool>>(width, QVector<bool>(height, false));
-
-     for(const QPoint& p : selectedPixels)
-     {
-        selectedPixelsVector[p.x()][p.y()] = true;
-     }
-
-     return selectedPixelsVector;
-}
-
 int limitMax(const int& value, const int& max)
 {
     if(value > max)
@@ -851,266 +993,228 @@ int limitChangeToTarget(const int& original, const int& target, const int& maxMo
     }
 }
 
-QImage blurImage(QImage& originalImage,
-                 const QVector<QVector<bool>>& pixelsArray, const QVector<QPoint>& pixelsList,
-                 const int& blurValue, const int& maxDifference, const bool& includeTransparent)
+//Box blur using sliding window sums, so cost doesnt grow with blurValue.
+//  Running column sums (over rows y - blurValue -> y + blurValue) are kept per band of rows,
+//  each output row is then a sliding sum along those columns.
+//  selectedPixels is a row major width * height mask of pixels to blur and to sample from, or nullptr for the whole image.
+QImage boxBlurImage(const QImage& sourceImage, const uchar* selectedPixels,
+                    const int& blurValue, const int& maxDifference, const bool& includeTransparent)
 {
     if(blurValue == 0 || maxDifference == 0)
     {
-        return originalImage;
+        return sourceImage;
     }
 
+    const QImage originalImage = PixelKernels::toArgb32(sourceImage);
+
     QImage bluredImage = originalImage;
 
-    //Data to be used in loop
-    QColor originalColor;
-    QColor neighbourColor;
-    int a;
-    int r;
-    int g;
-    int b;
-    int neighborPixels;
-    int startX;
-    int endX;
-    int startY;
-    int endY;
+    const int width = originalImage.width();
+    const int height = originalImage.height();
+    const uchar* originalBits = originalImage.constBits();
+    const qsizetype originalBytesPerLine = originalImage.bytesPerLine();
+    uchar* bluredBits = bluredImage.bits();//Detach before going across threads
+    const qsizetype bluredBytesPerLine = bluredImage.bytesPerLine();
 
-    for(const QPoint& p : pixelsList)
+    auto isSelected = [&](const int x, const int y)-> bool
     {
-        //Get original color of pixel under operation
-        originalColor = originalImage.pixelColor(p.x(), p.y());
+        return selectedPixels == nullptr || selectedPixels[y * width + x];
+    };
 
-        if(originalColor.alpha() == 0)
-        {
-            continue;
-        }
+    //Each band primes its column sums with 2 * blurValue rows, so keep bands a few windows tall
+    const int minRowsPerBand = 4 * blurValue;
 
-        if(includeTransparent)
-            a = originalColor.alpha();
-        r = originalColor.red();
-        g = originalColor.green();
-        b = originalColor.blue();
-        neighborPixels = 1;
-
-        //Loop through a box around pixel under operation (blurValue width and height)
-        //Collect r,g,b colors of the pixels in box
-        startX = p.x() - blurValue >= 0 ? p.x() - blurValue : 0;
-        endX = p.x() + blurValue < originalImage.width() ? p.x() + blurValue : originalImage.width();
-        startY = p.y() - blurValue >= 0 ? p.y() - blurValue : 0;
-        endY = p.y() + blurValue < originalImage.height() ? p.y() + blurValue : originalImage.height();
-        for(int x = startX; x <= endX; x++)
-        {
-            for(int y = startY; y <= endY; y++)
+    PixelKernels::operateOnRowBandsConcurrent(width, height, [&](const int firstRow, const int endRow)-> void
+    {
+        //Sums of non transparent selected pixels in each column of the window, and the count of selected pixels
+        QVector<int> columnR(width, 0);
+        QVector<int> columnG(width, 0);
+        QVector<int> columnB(width, 0);
+        QVector<int> columnA(width, 0);
+        QVector<int> columnOpaque(width, 0);
+        QVector<int> columnSelected(width, 0);
+
+        auto addRow = [&](const int y, const int sign)-> void
+        {
+            const QRgb* line = reinterpret_cast<const QRgb*>(originalBits + y * originalBytesPerLine);
+            for(int x = 0; x < width; x++)
             {
-                if(pixelsArray[x][y])
+                if(!isSelected(x, y))
                 {
-                    neighbourColor = originalImage.pixelColor(x, y);
-                    if(neighbourColor.alpha() != 0)
-                    {
-                        r += neighbourColor.red();
-                        g += neighbourColor.green();
-                        b += neighbourColor.blue();                        
-                        if(includeTransparent)
-                            a += neighbourColor.alpha();
-
-                        neighborPixels++;
-                    }
-                    else if(includeTransparent)
-                    {
-                        r += originalColor.red();
-                        g += originalColor.green();
-                        b += originalColor.blue();
-                        a += neighbourColor.alpha();
-                        neighborPixels++;
-                    }
+                    continue;
                 }
-            }
-        }
-
-        int newR = limitChangeToTarget(originalColor.red(), r/neighborPixels, maxDifference, Constants::MinRgbValue, Constants::MaxRgbValue);
-        int newG = limitChangeToTarget(originalColor.green(), g/neighborPixels, maxDifference, Constants::MinRgbValue, Constants::MaxRgbValue);
-        int newB = limitChangeToTarget(originalColor.blue(), b/neighborPixels, maxDifference,Constants::MinRgbValue, Constants::MaxRgbValue);
-        int newA = includeTransparent ? limitChangeToTarget(originalColor.alpha(), a/neighborPixels, maxDifference, Constants::MinRgbValue, Constants::MaxRgbValue) : originalColor.alpha();
 
-        //Average combined r,g,b values and set new pixel under operation
-        bluredImage.setPixelColor(p.x(), p.y(), QColor(newR, newG, newB, newA));
-    }
-
-    return bluredImage;
-}
+                columnSelected[x] += sign;
 
-QImage blurImage(QImage& originalImage, const int& blurValue, const int& maxDifference, const bool& includeTransparent)
-{
-    if(blurValue == 0 || maxDifference == 0)
-    {
-        return originalImage;
-    }
-
-    QImage bluredImage = originalImage;
+                const QRgb col = line[x];
+                if(qAlpha(col) != 0)
+                {
+                    columnR[x] += sign * qRed(col);
+                    columnG[x] += sign * qGreen(col);
+                    columnB[x] += sign * qBlue(col);
+                    columnA[x] += sign * qAlpha(col);
+                    columnOpaque[x] += sign;
+                }
+            }
+        };
 
-    //Data to be used in loop
-    QColor originalColor;
-    QColor neighbourColor;
-    int a;
-    int r;
-    int g;
-    int b;
-    int neighborPixels;
-    int startX;
-    int endX;
-    int startY;
-    int endY;
+        //Prime window for firstRow (last row is added at the start of the loop)
+        for(int y = firstRow - blurValue > 0 ? firstRow - blurValue : 0; y < firstRow + blurValue && y < height; y++)
+        {
+            addRow(y, 1);
+        }
 
-    for(int x = 0; x < bluredImage.width(); x++)
-    {
-        for(int y = 0; y < bluredImage.height(); y++)
+        for(int y = firstRow; y < endRow; y++)
         {
-            //Get original color of pixel under operation
-            originalColor = originalImage.pixelColor(x, y);
+            //Slide window down to cover y - blurValue -> y + blurValue
+            if(y + blurValue < height)
+            {
+                addRow(y + blurValue, 1);
+            }
+            if(y - blurValue - 1 >= 0 && y != firstRow)
+            {
+                addRow(y - blurValue - 1, -1);
+            }
 
-            if(originalColor.alpha() == 0)
+            const QRgb* originalLine = reinterpret_cast<const QRgb*>(originalBits + y * originalBytesPerLine);
+            QRgb* bluredLine = reinterpret_cast<QRgb*>(bluredBits + y * bluredBytesPerLine);
+
+            //Window sums along the row, covering columns x - blurValue -> x + blurValue
+            int r = 0;
+            int g = 0;
+            int b = 0;
+            int a = 0;
+            int opaque = 0;
+            int selected = 0;
+            for(int x = 0; x < blurValue && x < width; x++)
             {
-                continue;
+                r += columnR[x];
+                g += columnG[x];
+                b += columnB[x];
+                a += columnA[x];
+                opaque += columnOpaque[x];
+                selected += columnSelected[x];
             }
 
-            if(includeTransparent)
-                a = originalColor.alpha();
-            r = originalColor.red();
-            g = originalColor.green();
-            b = originalColor.blue();
-            neighborPixels = 1;
-
-            //Loop through a box around pixel under operation (blurValue width and height)
-            //Collect r,g,b colors of the pixels in box
-            startX = x - blurValue >= 0 ? x - blurValue : 0;
-            endX = x + blurValue < originalImage.width() ? x + blurValue : originalImage.width();
-            startY = y - blurValue >= 0 ? y - blurValue : 0;
-            endY = y + blurValue < originalImage.height() ? y + blurValue : originalImage.height();
-            for(int x = startX; x <= endX; x++)
+            for(int x = 0; x < width; x++)
             {
-                for(int y = startY; y <= endY; y++)
+                const int addX = x + blurValue;
+                if(addX < width)
                 {
-                    neighbourColor = originalImage.pixelColor(x, y);
-                    if(neighbourColor.alpha() != 0)
-                    {
-                        r += neighbourColor.red();
-                        g += neighbourColor.green();
-                        b += neighbourColor.blue();
+                    r += columnR[addX];
+                    g += columnG[addX];
+                    b += columnB[addX];
+                    a += columnA[addX];
+                    opaque += columnOpaque[addX];
+                    selected += columnSelected[addX];
+                }
+                const int removeX = x - blurValue - 1;
+                if(removeX >= 0)
+                {
+                    r -= columnR[removeX];
+                    g -= columnG[removeX];
+                    b -= columnB[removeX];
+                    a -= columnA[removeX];
+                    opaque -= columnOpaque[removeX];
+                    selected -= columnSelected[removeX];
+                }
 
-                        if(includeTransparent)
-                            a += neighbourColor.alpha();
+                //Get original color of pixel under operation
+                const QRgb originalColor = originalLine[x];
 
-                        neighborPixels++;
-                    }
-                    else if(includeTransparent)
-                    {
-                        r += originalColor.red();
-                        g += originalColor.green();
-                        b += originalColor.blue();
-                        a += neighbourColor.alpha();
-                        neighborPixels++;
-                    }
+                if(qAlpha(originalColor) == 0 || !isSelected(x, y))
+                {
+                    continue;
                 }
-            }
-
-            int newR = limitChangeToTarget(originalColor.red(), r/neighborPixels, maxDifference, Constants::MinRgbValue, Constants::MaxRgbValue);
-            int newG = limitChangeToTarget(originalColor.green(), g/neighborPixels, maxDifference, Constants::MinRgbValue, Constants::MaxRgbValue);
-            int newB = limitChangeToTarget(originalColor.blue(), b/neighborPixels, maxDifference, Constants::MinRgbValue, Constants::MaxRgbValue);
-            int newA = includeTransparent ? limitChangeToTarget(originalColor.alpha(), a/neighborPixels, maxDifference, Constants::MinRgbValue, Constants::MaxRgbValue) : originalColor.alpha();
 
-            //Average combined r,g,b values and set new pixel under operation
-            bluredImage.setPixelColor(x, y, QColor(newR, newG, newB, newA));
+                //Pixel under operation counts once more on top of the box.
+                //  With includeTransparent, transparent neighbours add the original color and no alpha
+                const int transparent = includeTransparent ? selected - opaque : 0;
+                const int neighborPixels = 1 + opaque + transparent;
+                const int sumR = qRed(originalColor) * (1 + transparent) + r;
+                const int sumG = qGreen(originalColor) * (1 + transparent) + g;
+                const int sumB = qBlue(originalColor) * (1 + transparent) + b;
+                const int sumA = qAlpha(originalColor) + a;
+
+                const int newR = limitChangeToTarget(qRed(originalColor), sumR/neighborPixels, maxDifference, Constants::MinRgbValue, Constants::MaxRgbValue);
+                const int newG = limitChangeToTarget(qGreen(originalColor), sumG/neighborPixels, maxDifference, Constants::MinRgbValue, Constants::MaxRgbValue);
+                const int newB = limitChangeToTarget(qBlue(originalColor), sumB/neighborPixels, maxDifference, Constants::MinRgbValue, Constants::MaxRgbValue);
+                const int newA = includeTransparent ? limitChangeToTarget(qAlpha(originalColor), sumA/neighborPixels, maxDifference, Constants::MinRgbValue, Constants::MaxRgbValue) : qAlpha(originalColor);
+
+                //Average combined r,g,b values and set new pixel under operation
+                bluredLine[x] = qRgba(newR, newG, newB, newA);
+            }
         }
-    }
+    }, minRowsPerBand);
 
     return bluredImage;
 }
 
-void Canvas::onNormalBlur(const int& maxDifference, const int& averageArea, const bool& includeTransparent)
+//Blurs only selected pixels, sampling only from selected pixels.
+//  As nothing outside the selection is read or written, only its bounding rect is blurred (the window is clipped
+//  at the rect's edges, where there are no selected pixels left to sample anyway).
+QImage blurImage(const QImage& originalImage, const SelectionMask& pixels,
+                 const int& blurValue, const int& maxDifference, const bool& includeTransparent)
 {
-    //check if were doing the whole image or just some selected pixels
-    if(m_pClipboardPixels->clipboardActive())
+    const QRect rect = pixels.boundingRect().intersected(originalImage.rect());
+    if(blurValue == 0 || maxDifference == 0 || rect.isEmpty())
     {
-        m_pClipboardPixels->setClipboard(getClipboardBeforeEffects());
-
-        m_pClipboardPixels->m_clipboardImage = blurImage(m_pClipboardPixels->m_clipboardImage,
-                                                         listTo2dVector(m_pClipboardPixels->getPixels(), m_pClipboardPixels->m_clipboardImage.width(), m_pClipboardPixels->m_clipboardImage.height()),
-                                                         m_pClipboardPixels->getPixels(),
-                                                         averageArea, maxDifference, includeTransparent);
+        return originalImage;
     }
-    else if(m_pClipboardPixels->containsPixels())
-    {
-        //Get backup of canvas image before effects were applied (create backup if first effect)
-        m_canvasLayers[m_selectedLayer].m_image = getCanvasImageBeforeEffects(); //Assumes there is a selected layer
 
-        m_canvasLayers[m_selectedLayer].m_image = blurImage(m_canvasLayers[m_selectedLayer].m_image,
-                                                         listTo2dVector(m_pClipboardPixels->getPixels(), m_canvasLayers[m_selectedLayer].m_image.width(), m_canvasLayers[m_selectedLayer].m_image.height()),
-                                                         m_pClipboardPixels->getPixels(),
-                                                         averageArea, maxDifference, includeTransparent);
-    }
-    else
+    const int width = rect.width();
+    QVector<uchar> selectedPixels(width * rect.height(), 0);
+    pixels.forEachSpanInRect(rect, [&](const int y, const int left, const int right)-> void
     {
-        //Get backup of canvas image before effects were applied (create backup if first effect)
-        m_canvasLayers[m_selectedLayer].m_image = getCanvasImageBeforeEffects(); //Assumes there is a selected layer
+        const int rowStart = (y - rect.top()) * width - rect.left();
+        std::fill(selectedPixels.begin() + rowStart + left, selectedPixels.begin() + rowStart + right + 1, 1);
+    });
 
-        m_canvasLayers[m_selectedLayer].m_image = blurImage(m_canvasLayers[m_selectedLayer].m_image, averageArea, maxDifference, includeTransparent);
-    }
-
-    //Record history is done in onConfirmEffects()
-
-    update();
-}
+    QImage bluredImage = PixelKernels::toArgb32(originalImage);
+    const QImage bluredRect = boxBlurImage(bluredImage.copy(rect), selectedPixels.constData(), blurValue, maxDifference, includeTransparent);
 
-QColor colorMultipliersPixel(const QColor& originalColor, const float& redXred, const float& redXgreen, const float& redXblue, const float& greenXred, const float& greenXgreen, const float& greenXblue, const float& blueXred, const float& blueXgreen, const float& blueXblue, const float& xTransparent)
-{
-    const int newR = limitMax(originalColor.red() * redXred + originalColor.green() * redXgreen + originalColor.blue() * redXblue, Constants::MaxRgbValue);
-    const int newG = limitMax(originalColor.red() * greenXred + originalColor.green() * greenXgreen + originalColor.blue() * greenXblue, Constants::MaxRgbValue);
-    const int newB = limitMax(originalColor.red() * blueXred + originalColor.green() * blueXgreen + originalColor.blue() * blueXblue, Constants::MaxRgbValue);
-    const int newA = originalColor.alpha() * xTransparent;
-    return QColor(newR, newG, newB, newA);
-}
-
-void colorMultipliers(QImage& image, const QVector<QPoint>& pixelsList, const float& redXred, const float& redXgreen, const float& redXblue, const float& greenXred, const float& greenXgreen, const float& greenXblue, const float& blueXred, const float& blueXgreen, const float& blueXblue, const float& xTransparent)
-{
-    for(const QPoint& p : pixelsList)
+    //Unselected pixels in rect come back unchanged, so whole rows are copied
+    const size_t rowBytes = size_t(width) * sizeof(QRgb);
+    for(int y = 0; y < rect.height(); y++)
     {
-        image.setPixelColor(p.x(), p.y(), colorMultipliersPixel(image.pixelColor(p.x(), p.y()), redXred, redXgreen, redXblue, greenXred, greenXgreen, greenXblue, blueXred, blueXgreen, blueXblue, xTransparent));
+        std::memcpy(bluredImage.scanLine(rect.top() + y) + rect.left() * sizeof(QRgb), bluredRect.constScanLine(y), rowBytes);
     }
+    return bluredImage;
 }
 
-void colorMultipliers(QImage& image, const float& redXred, const float& redXgreen, const float& redXblue, const float& greenXred, const float& greenXgreen, const float& greenXblue, const float& blueXred, const float& blueXgreen, const float& blueXblue, const float& xTransparent)
+QImage blurImage(const QImage& originalImage, const int& blurValue, const int& maxDifference, const bool& includeTransparent)
 {
-    for(int x = 0; x < image.width(); x++)
-    {
-        for(int y = 0; y < image.height(); y++)
-        {
-            image.setPixelColor(x, y, colorMultipliersPixel(image.pixelColor(x, y), redXred, redXgreen, redXblue, greenXred, greenXgreen, greenXblue, blueXred, blueXgreen, blueXblue, xTransparent));
-        }
-    }
+    return boxBlurImage(originalImage, nullptr, blurValue, maxDifference, includeTransparent);
 }
 
-void Canvas::onColorMultipliers(const int redXred, const int redXgreen, const int redXblue, const int greenXred, const int greenXgreen, const int greenXblue, const int blueXred, const int blueXgreen, const int blueXblue, const int xTransparent)
+void Canvas::onNormalBlur(const int& maxDifference, const int& averageArea, const bool& includeTransparent)
 {
     //check if were doing the whole image or just some selected pixels
     if(m_pClipboardPixels->clipboardActive())
     {
         m_pClipboardPixels->setClipboard(getClipboardBeforeEffects());
 
-        colorMultipliers(m_pClipboardPixels->m_clipboardImage, m_pClipboardPixels->getPixels(), (float)redXred/100, (float)redXgreen/100, (float)redXblue/100, (float)greenXred/100, (float)greenXgreen/100, (float)greenXblue/100, (float)blueXred/100, (float)blueXgreen/100, (float)blueXblue/100, (float)xTransparent/100);
+        m_pClipboardPixels->m_clipboardImage = blurImage(m_pClipboardPixels->m_clipboardImage,
+                                                         m_pClipboardPixels->getPixels(),
+                                                         averageArea, maxDifference, includeTransparent);
     }
     else if(m_pClipboardPixels->containsPixels())
     {
         //Get backup of canvas image before effects were applied (create backup if first effect)
         m_canvasLayers[m_selectedLayer].m_image = getCanvasImageBeforeEffects(); //Assumes there is a selected layer
 
-        colorMultipliers(m_canvasLayers[m_selectedLayer].m_image, m_pClipboardPixels->getPixels(), (float)redXred/100, (float)redXgreen/100, (float)redXblue/100, (float)greenXred/100, (float)greenXgreen/100, (float)greenXblue/100, (float)blueXred/100, (float)blueXgreen/100, (float)blueXblue/100, (float)xTransparent/100);
+        m_canvasLayers[m_selectedLayer].m_image = blurImage(m_canvasLayers[m_selectedLayer].m_image,
+                                                         m_pClipboardPixels->getPixels(),
+                                                         averageArea, maxDifference, includeTransparent);
     }
     else
     {
-        //Get backup of canvas image before effects were applied (create backup if first effect)
-        m_canvasLayers[m_selectedLayer].m_image = getCanvasImageBeforeEffects(); //Assumes there is a selected layer
-
-        colorMultipliers(m_canvasLayers[m_selectedLayer].m_image, (float)redXred/100, (float)redXgreen/100, (float)redXblue/100, (float)greenXred/100, (float)greenXgreen/100, (float)greenXblue/100, (float)blueXred/100, (float)blueXgreen/100, (float)blueXblue/100, (float)xTransparent/100);
+        //Reads averageArea pixels around each pixel
+        previewLayerEffect([maxDifference, averageArea, includeTransparent](const QImage& beforeEffects)-> QImage
+        {
+            QImage image = beforeEffects;
+            return blurImage(image, averageArea, maxDifference, includeTransparent);
+        }, averageArea);
     }
 
     //Record history is done in onConfirmEffects()
@@ -1118,79 +1222,42 @@ void Canvas::onColorMultipliers(const int redXred, const int redXgreen, const in
     update();
 }
 
-int limitRange(const int& value, const int& min, const int& max)
+void Canvas::onColorMultipliers(const int redXred, const int redXgreen, const int redXblue, const int greenXred, const int greenXgreen, const int greenXblue, const int blueXred, const int blueXgreen, const int blueXblue, const int xTransparent)
 {
-    if(value > max)
-    {
-        return max;
-    }
-
-    if(value < min)
-    {
-        return min;
-    }
+    PixelKernels::ColorMultipliers& multipliers = m_adjustments.multipliers;
+    multipliers.redXred = (float)redXred/100;
+    multipliers.redXgreen = (float)redXgreen/100;
+    multipliers.redXblue = (float)redXblue/100;
+    multipliers.greenXred = (float)greenXred/100;
+    multipliers.greenXgreen = (float)greenXgreen/100;
+    multipliers.greenXblue = (float)greenXblue/100;
+    multipliers.blueXred = (float)blueXred/100;
+    multipliers.blueXgreen = (float)blueXgreen/100;
+    multipliers.blueXblue = (float)blueXblue/100;
+    multipliers.xTransparent = (float)xTransparent/100;
 
-    return value;
+    applyAdjustments();
 }
 
-void setImageHueAndSaturation(QImage& image, const QVector<QPoint>& pixelsList, const int& hue, const int& saturation)
+void Canvas::onHueSaturation(const int &hue, const int &saturation)
 {
-    int h,s,v;
-    for(const QPoint& p : pixelsList)
-    {
-        const QColor originalColor = image.pixelColor(p.x(), p.y());
-        if(originalColor.alpha() > 0)
-        {
-            originalColor.getHsv(&h, &s, &v);
-            image.setPixelColor(p.x(), p.y(), QColor::fromHsv(limitRange(h + hue, Constants::MinHue, Constants::MaxHue), limitRange(s + saturation, Constants::MinSaturation, Constants::MaxSaturation), v, originalColor.alpha()));
-        }
-    }
-}
+    m_adjustments.hueSaturation = true;
+    m_adjustments.hue = hue;
+    m_adjustments.saturation = saturation;
 
-void setImageHueAndSaturation(QImage& image, const int& hue, const int& saturation)
-{
-    int h,s,v;
-    for(int x = 0; x < image.width(); x++)
-    {
-        for(int y = 0; y < image.height(); y++)
-        {
-            const QColor originalColor = image.pixelColor(x, y);
-            if(originalColor.alpha() > 0)
-            {
-                originalColor.getHsv(&h, &s, &v);
-                image.setPixelColor(x, y, QColor::fromHsv(limitRange(h + hue, Constants::MinHue, Constants::MaxHue), limitRange(s + saturation, Constants::MinSaturation, Constants::MaxSaturation), v, originalColor.alpha()));
-            }
-        }
-    }
+    applyAdjustments();
 }
 
-void Canvas::onHueSaturation(const int &hue, const int &saturation)
+void Canvas::onLevels(const int inputBlack, const int inputWhite, const int gamma, const int outputBlack, const int outputWhite)
 {
-    //check if were doing the whole image or just some selected pixels
-    if(m_pClipboardPixels->clipboardActive())
-    {
-        m_pClipboardPixels->setClipboard(getClipboardBeforeEffects());
-
-        setImageHueAndSaturation(m_pClipboardPixels->m_clipboardImage, m_pClipboardPixels->getPixels(), hue, saturation);
-    }
-    else if(m_pClipboardPixels->containsPixels())
-    {
-        //Get backup of canvas image before effects were applied (create backup if first effect)
-        m_canvasLayers[m_selectedLayer].m_image = getCanvasImageBeforeEffects(); //Assumes there is a selected layer
+    PixelKernels::Levels& levels = m_adjustments.levels;
+    levels.inputBlack = inputBlack;
+    levels.inputWhite = inputWhite;
+    levels.gamma = (float)gamma/100;
+    levels.outputBlack = outputBlack;
+    levels.outputWhite = outputWhite;
 
-        setImageHueAndSaturation(m_canvasLayers[m_selectedLayer].m_image, m_pClipboardPixels->getPixels(), hue, saturation);
-    }
-    else
-    {
-        //Get backup of canvas image before effects were applied (create backup if first effect)
-        m_canvasLayers[m_selectedLayer].m_image = getCanvasImageBeforeEffects(); //Assumes there is a selected layer
-
-        setImageHueAndSaturation(m_canvasLayers[m_selectedLayer].m_image, hue, saturation);
-    }
-
-    //Record history is done in onConfirmEffects()
-
-    update();
+    applyAdjustments();
 }
 
 void Canvas::onOutlineEffect(const int sensitivity)
@@ -1201,10 +1268,6 @@ void Canvas::onOutlineEffect(const int sensitivity)
         return;
     }
 
-    QImage outlineSketch = QImage(QSize(m_canvasLayers[m_selectedLayer].m_image.width(), m_canvasLayers[m_selectedLayer].m_image.height()), QImage::Format_ARGB32);
-    //Laying this ontop of m_canvasImage so want most of it transparent
-    outlineSketch.fill(Qt::transparent);
-
     const QColor sketchColor = m_pParent->getSelectedColor();
 
     //check if were doing the whole image or just some selected pixels
@@ -1212,45 +1275,59 @@ void Canvas::onOutlineEffect(const int sensitivity)
     {
         m_pClipboardPixels->setClipboard(getClipboardBeforeEffects());
 
+        //Laying this ontop of the image so want most of it transparent
+        const QRect selectedRect = m_pClipboardPixels->m_pixels.boundingRect();
+        QImage outlineSketch = QImage(selectedRect.size(), QImage::Format_ARGB32);
+        outlineSketch.fill(Qt::transparent);
+
         //Loop through selected pixels
         m_pClipboardPixels->operateOnSelectedPixels([&](int x, int y)-> void
         {
-            checkCreateSketchOnPixel(m_pClipboardPixels->m_clipboardImage, outlineSketch, x, y, sketchColor, sensitivity);
+            checkCreateSketchOnPixel(m_pClipboardPixels->m_clipboardImage, outlineSketch, selectedRect.topLeft(), x, y, sketchColor, sensitivity);
         });
 
         //Dump outline sketch onto m_canvasImage
         QPainter sketchPainter(&m_pClipboardPixels->m_clipboardImage);
-        sketchPainter.drawImage(0,0,outlineSketch);
+        sketchPainter.drawImage(selectedRect.topLeft(), outlineSketch);
     }
     else if(m_pClipboardPixels->containsPixels())
     {
         //Get backup of canvas image before effects were applied (create backup if first effect)
         m_canvasLayers[m_selectedLayer].m_image = getCanvasImageBeforeEffects();
 
+        //Laying this ontop of the image so want most of it transparent
+        const QRect selectedRect = m_pClipboardPixels->m_pixels.boundingRect();
+        QImage outlineSketch = QImage(selectedRect.size(), QImage::Format_ARGB32);
+        outlineSketch.fill(Qt::transparent);
+
         //Loop through selected pixels
         m_pClipboardPixels->operateOnSelectedPixels([&](int x, int y)-> void
         {
-            checkCreateSketchOnPixel(m_canvasLayers[m_selectedLayer].m_image, outlineSketch, x, y, sketchColor, sensitivity);
+            checkCreateSketchOnPixel(m_canvasLayers[m_selectedLayer].m_image, outlineSketch, selectedRect.topLeft(), x, y, sketchColor, sensitivity);
         });
 
         //Dump outline sketch onto m_canvasImage
         QPainter sketchPainter(&m_canvasLayers[m_selectedLayer].m_image);
-        sketchPainter.drawImage(0,0,outlineSketch);
+        sketchPainter.drawImage(selectedRect.topLeft(), outlineSketch);
     }
     else
     {
-        //Get backup of canvas image before effects were applied (create backup if first effect)
-        m_canvasLayers[m_selectedLayer].m_image = getCanvasImageBeforeEffects();
-
-        //Loop through pixels, if a border pixel set it to sketchColor
-        operateOnCanvasPixels(m_canvasLayers[m_selectedLayer].m_image, [&](int x, int y)-> void
+        //Reads the pixels next to each pixel
+        previewLayerEffect([sketchColor, sensitivity](const QImage& beforeEffects)-> QImage
         {
-            checkCreateSketchOnPixel(m_canvasLayers[m_selectedLayer].m_image, outlineSketch, x, y, sketchColor, sensitivity);
-        });
+            QImage image = beforeEffects;
+            QImage outlineSketch = QImage(image.size(), QImage::Format_ARGB32);
+            outlineSketch.fill(Qt::transparent);
 
-        //Dump outline sketch onto m_canvasImage
-        QPainter sketchPainter(&m_canvasLayers[m_selectedLayer].m_image);
-        sketchPainter.drawImage(0,0,outlineSketch);
+            //Loop through pixels, if a border pixel set it to sketchColor
+            createSketchOnImage(image, outlineSketch, sketchColor, sensitivity);
+
+            //Dump outline sketch onto image
+            QPainter sketchPainter(&image);
+            sketchPainter.drawImage(0,0,outlineSketch);
+            sketchPainter.end();
+            return image;
+        }, 1);
     }
 
     //Record history is done in onConfirmEffects()
@@ -1258,28 +1335,35 @@ void Canvas::onOutlineEffect(const int sensitivity)
     update();
 }
 
-int limitValidRgb(const int& num)
+void Canvas::onBrightness(const int value)
 {
-    return limitRange(num, Constants::MinRgbValue, Constants::MaxRgbValue);
+    m_adjustments.brightness = value;
+
+    applyAdjustments();
 }
 
-QColor changeBrightness(QColor col, const int value)
+void Canvas::onContrast(const int value)
 {
-    return QColor(limitValidRgb(col.red() + value), limitValidRgb(col.green() + value), limitValidRgb(col.blue() + value), col.alpha());
+    m_adjustments.contrast = value;
+
+    applyAdjustments();
 }
 
-void Canvas::onBrightness(const int value)
+void Canvas::applyAdjustments()
 {
+    const PixelKernels::PreparedAdjustments adjustments = PixelKernels::prepareAdjustments(m_adjustments);
+    const auto adjustKernel = [adjustments](const QRgb col)-> QRgb
+    {
+        return PixelKernels::adjustPixel(col, adjustments);
+    };
+
     //check if were doing the whole image or just some selected pixels
     if(m_pClipboardPixels->clipboardActive())
     {
         m_pClipboardPixels->setClipboard(getClipboardBeforeEffects());
 
         //Loop through selected pixels
-        m_pClipboardPixels->operateOnSelectedPixels([&](int x, int y)-> void
-        {
-            m_pClipboardPixels->m_clipboardImage.setPixelColor(x, y, changeBrightness(m_pClipboardPixels->m_clipboardImage.pixelColor(x,y), value));
-        });
+        PixelKernels::operateOnPixels(m_pClipboardPixels->m_clipboardImage, m_pClipboardPixels->getPixels(), adjustKernel);
     }
     else if(m_pClipboardPixels->containsPixels())
     {
@@ -1287,20 +1371,19 @@ void Canvas::onBrightness(const int value)
         m_canvasLayers[m_selectedLayer].m_image = getCanvasImageBeforeEffects();
 
         //Loop through selected pixels
-        m_pClipboardPixels->operateOnSelectedPixels([&](int x, int y)-> void
-        {
-            m_canvasLayers[m_selectedLayer].m_image.setPixelColor(x, y, changeBrightness(m_canvasLayers[m_selectedLayer].m_image.pixelColor(x,y), value));
-        });
+        PixelKernels::operateOnPixels(m_canvasLayers[m_selectedLayer].m_image, m_pClipboardPixels->getPixels(), adjustKernel);
     }
     else
     {
-        //Get backup of canvas image before effects were applied (create backup if first effect)
-        m_canvasLayers[m_selectedLayer].m_image = getCanvasImageBeforeEffects();
-
-        operateOnCanvasPixels(m_canvasLayers[m_selectedLayer].m_image, [&](int x, int y)-> void
+        previewLayerEffect([adjustments](const QImage& beforeEffects)-> QImage
         {
-            m_canvasLayers[m_selectedLayer].m_image.setPixelColor(x, y, changeBrightness(m_canvasLayers[m_selectedLayer].m_image.pixelColor(x,y), value));
-        });
+            QImage image = beforeEffects;
+            PixelKernels::operateOnScanlinesConcurrent(image, [&](QRgb* line, const int, const int width)-> void
+            {
+                PixelKernels::adjust(line, width, adjustments);
+            });
+            return image;
+        }, 0);
     }
 
     //Record history is done in onConfirmEffects()
@@ -1308,121 +1391,285 @@ void Canvas::onBrightness(const int value)
     update();
 }
 
-
-int changeContrastRGOB(const int rgob, const int value) // rgob --> stands for red, green or blue
+void Canvas::onConfirmEffects()
 {
-    //Constants::MiddleRgbValue is middle of Constants::MinRgbValue and Constants::MaxRgbValue, dulling contrast(<0) moves towards MiddleRgbValue, high contrast(>0) moves away.
-
-    if(rgob > Constants::MiddleRgbValue)
+    //Already confirmed, onLayerEffectApplied finishes the confirm once the pass is done
+    if(m_bApplyingLayerEffect)
     {
-        if(value > 0)
-        {
-            return limitMax(rgob + value, Constants::MaxRgbValue);
-        }
-        else if(value < 0)
-        {
-            return limitMin(rgob + value, Constants::MiddleRgbValue);
-        }
+        return;
     }
-    else if(rgob < Constants::MiddleRgbValue)
+
+    //Adjustments from here on start a new stack (a whole layer effect has its own copy)
+    m_adjustments = PixelKernels::Adjustments();
+
+    if(m_layerEffect)
     {
-        if(value > 0)
-        {
-            return limitMin(rgob - value, Constants::MinRgbValue);
-        }
-        else if(value < 0)
+        //Full resolution pass on a worker, the preview is shown until it's done (history is recorded in onLayerEffectApplied)
+        const std::function<QImage(const QImage&)> layerEffect = m_layerEffect;
+        const QImage beforeEffects = m_beforeEffectsImage;
+        m_layerEffectTargetKey = m_canvasLayers[m_selectedLayer].m_image.cacheKey();
+        m_bApplyingLayerEffect = true;
+        m_pEffectPreviewScheduler->cancel();//Leaves the pool to the full resolution pass
+        m_pLayerEffectWatcher->setFuture(QtConcurrent::run([layerEffect, beforeEffects]()-> QImage
         {
-            return limitMax(rgob - value, Constants::MiddleRgbValue);
-        }
+            return layerEffect(beforeEffects);
+        }));
+
+        //Busy indicator, blocks input to the canvas if the pass takes long enough for it to show
+        m_pLayerEffectProgress = new QProgressDialog(Constants::EffectApplyProgressText, QString(), 0, 0, this);
+        m_pLayerEffectProgress->setWindowModality(Qt::ApplicationModal);
+        m_pLayerEffectProgress->setMinimumDuration(Constants::EffectApplyProgressDelay);
+        m_pLayerEffectProgress->setValue(0);
+        return;
     }
 
-    return rgob;
+    m_beforeEffectsImage = QImage();
+    m_beforeEffectsClipboard.m_clipboardImage = QImage();
+    m_beforeEffectsClipboard.m_pixels.clear();
+    recordHistory();
 }
 
-QColor changeContrast(QColor col, const int value)
+void Canvas::onCancelEffects()
 {
-    return QColor(changeContrastRGOB(col.red(), value), changeContrastRGOB(col.green(), value), changeContrastRGOB(col.blue(), value), col.alpha());
+    //A confirmed effect cant be cancelled, it's finished first so the layer isnt restored underneath it
+    waitForLayerEffect();
+
+    clearLayerEffect();
+    m_adjustments = PixelKernels::Adjustments();
+
+    if(m_beforeEffectsImage != QImage())
+    {
+        m_canvasLayers[m_selectedLayer].m_image = m_beforeEffectsImage;
+        m_beforeEffectsImage = QImage();
+    }
+    else if(m_beforeEffectsClipboard.m_clipboardImage != QImage())
+    {
+        m_pClipboardPixels->setClipboard(m_beforeEffectsClipboard);
+        m_beforeEffectsClipboard.m_clipboardImage = QImage();
+        m_beforeEffectsClipboard.m_pixels.clear();
+    }
 }
 
-void Canvas::onContrast(const int value)
+void Canvas::previewLayerEffect(const std::function<QImage(const QImage&)>& layerEffect, const int& margin)
 {
-    //check if were doing the whole image or just some selected pixels
-    if(m_pClipboardPixels->clipboardActive())
+    if(m_bApplyingLayerEffect)
     {
-        m_pClipboardPixels->setClipboard(getClipboardBeforeEffects());
+        return;
+    }
 
-        //Loop through selected pixels
-        m_pClipboardPixels->operateOnSelectedPixels([&](int x, int y)-> void
-        {
-            m_pClipboardPixels->m_clipboardImage.setPixelColor(x, y, changeContrast(m_pClipboardPixels->m_clipboardImage.pixelColor(x,y), value));
-        });
+    //Selected layer stays as it was before effects while previewing
+    m_canvasLayers[m_selectedLayer].m_image = getCanvasImageBeforeEffects(); //Assumes there is a selected layer
+
+    //Last frame stays up until one with the new effect is ready
+    m_layerEffect = layerEffect;
+    m_layerEffectMargin = margin;
+    m_bEffectPreviewStale = true;
+    update();
+}
+
+void Canvas::requestEffectPreview()
+{
+    const QImage& beforeEffects = m_canvasLayers[m_selectedLayer].m_image;
+    const QRect visibleRect = getWidgetRectOnCanvas(rect(), m_center, m_zoomFactor, m_panOffsetX, m_panOffsetY)
+                                .intersected(QRect(0, 0, m_canvasWidth, m_canvasHeight));
+
+    //Per pixel effects can run on the mip level being drawn (about screen resolution), others need full resolution
+    const int level = m_layerEffectMargin == 0 ? m_selectedLayerMips.sync(beforeEffects, MipPyramid::levelForZoom(m_zoomFactor)) : 0;
+
+    if(!m_bEffectPreviewStale && visibleRect == m_effectPreviewVisibleRect &&
+       level == m_effectPreviewLevel && beforeEffects.cacheKey() == m_effectPreviewSourceKey)
+    {
+        return;
     }
-    else if(m_pClipboardPixels->containsPixels())
+    m_bEffectPreviewStale = false;
+    m_effectPreviewVisibleRect = visibleRect;
+    m_effectPreviewLevel = level;
+    m_effectPreviewSourceKey = beforeEffects.cacheKey();
+
+    if(visibleRect.isEmpty())
     {
-        //Get backup of canvas image before effects were applied (create backup if first effect)
-        m_canvasLayers[m_selectedLayer].m_image = getCanvasImageBeforeEffects();
+        m_pEffectPreviewScheduler->cancel();
+        return;
+    }
 
-        //Loop through selected pixels
-        m_pClipboardPixels->operateOnSelectedPixels([&](int x, int y)-> void
+    //Frame is made on a worker - images are captured by (implicitly shared) copy, so edits on this thread detach from them
+    const std::function<QImage(const QImage&)> layerEffect = m_layerEffect;
+    if(level > 0)
+    {
+        const int levelScale = 1 << level;
+        const QRect levelRect = QRect(QPoint(visibleRect.left() / levelScale, visibleRect.top() / levelScale),
+                                      QPoint(visibleRect.right() / levelScale, visibleRect.bottom() / levelScale));
+        const QImage levelImage = m_selectedLayerMips.level(level);
+        m_effectPreviewRequestId = m_pEffectPreviewScheduler->schedule([layerEffect, levelImage, levelRect]()-> QImage
         {
-            m_canvasLayers[m_selectedLayer].m_image.setPixelColor(x, y, changeContrast(m_canvasLayers[m_selectedLayer].m_image.pixelColor(x,y), value));
+            return layerEffect(levelImage.copy(levelRect).convertToFormat(QImage::Format_ARGB32));
         });
+        m_effectPreviewRequestRect = QRect(levelRect.x() * levelScale, levelRect.y() * levelScale, levelRect.width() * levelScale, levelRect.height() * levelScale);
     }
     else
     {
-        //Get backup of canvas image before effects were applied (create backup if first effect)
-        m_canvasLayers[m_selectedLayer].m_image = getCanvasImageBeforeEffects();
-
-        operateOnCanvasPixels(m_canvasLayers[m_selectedLayer].m_image, [&](int x, int y)-> void
+        //Effect is run with a margin around the visible area, so pixels at its edges read the same neighbours they will on confirm
+        const QRect sourceRect = visibleRect.adjusted(-m_layerEffectMargin, -m_layerEffectMargin, m_layerEffectMargin, m_layerEffectMargin)
+                                    .intersected(beforeEffects.rect());
+        m_effectPreviewRequestId = m_pEffectPreviewScheduler->schedule([layerEffect, beforeEffects, sourceRect, visibleRect]()-> QImage
         {
-            m_canvasLayers[m_selectedLayer].m_image.setPixelColor(x, y, changeContrast(m_canvasLayers[m_selectedLayer].m_image.pixelColor(x,y), value));
+            return layerEffect(beforeEffects.copy(sourceRect)).copy(visibleRect.translated(-sourceRect.topLeft()));
         });
+        m_effectPreviewRequestRect = visibleRect;
     }
+}
 
-    //Record history is done in onConfirmEffects()
+void Canvas::onEffectPreviewReady(const quint64 id, const QImage frame)
+{
+    //Frames of previous requests are never emitted, this only filters out ones from before clearLayerEffect
+    if(!m_layerEffect || id != m_effectPreviewRequestId)
+    {
+        return;
+    }
 
+    m_effectPreviewImage = frame;
+    m_effectPreviewRect = m_effectPreviewRequestRect;
     update();
 }
 
-void Canvas::onConfirmEffects()
+void Canvas::clearLayerEffect()
 {
-    m_beforeEffectsImage = QImage();
-    m_beforeEffectsClipboard.m_clipboardImage = QImage();
-    m_beforeEffectsClipboard.m_pixels.clear();
-    m_canvasHistory.recordHistory(getSnapshot());
+    m_pEffectPreviewScheduler->cancel();
+    m_layerEffect = nullptr;
+    m_effectPreviewImage = QImage();
+    m_effectPreviewRect = QRect();
+    update();
 }
 
-void Canvas::onCancelEffects()
+void Canvas::waitForLayerEffect()
 {
-    if(m_beforeEffectsImage != QImage())
+    if(m_bApplyingLayerEffect)
     {
-        m_canvasLayers[m_selectedLayer].m_image = m_beforeEffectsImage;
+        m_pLayerEffectWatcher->waitForFinished();
+        onLayerEffectApplied();
+    }
+}
+
+void Canvas::onLayerEffectApplied()
+{
+    //Already handled by waitForLayerEffect
+    if(!m_bApplyingLayerEffect)
+    {
+        return;
+    }
+    m_bApplyingLayerEffect = false;
+
+    if(m_pLayerEffectProgress)
+    {
+        m_pLayerEffectProgress->deleteLater();
+        m_pLayerEffectProgress = nullptr;
+    }
+
+    clearLayerEffect();
+
+    //Layer the effect was confirmed on, found by its image (unedited while previewing, so its cacheKey is unchanged)
+    int targetLayer = -1;
+    if((int)m_selectedLayer < m_canvasLayers.size() && m_canvasLayers[m_selectedLayer].m_image.cacheKey() == m_layerEffectTargetKey)
+    {
+        targetLayer = m_selectedLayer;
+    }
+    for(int i = 0; i < m_canvasLayers.size() && targetLayer == -1; i++)
+    {
+        if(m_canvasLayers[i].m_image.cacheKey() == m_layerEffectTargetKey)
+        {
+            targetLayer = i;
+        }
+    }
+
+    if(targetLayer == -1)
+    {
+        qDebug() << "Canvas::onLayerEffectApplied - Layer was changed or removed during the effect, discarding it";
         m_beforeEffectsImage = QImage();
+        return;
     }
-    else if(m_beforeEffectsClipboard.m_clipboardImage != QImage())
+
+    m_canvasLayers[targetLayer].m_image = m_pLayerEffectWatcher->result();
+    onConfirmEffects();
+}
+
+QImage Canvas::getImageCopy()
+{
+    return m_canvasLayers[m_selectedLayer].m_image;
+}
+
+Tool Canvas::currentTool()
+{
+    return m_tool;
+}
+
+CanvasHistoryItem Canvas::getSnapshot()
+{
+    //Tiles that havnt changed since the snapshot the canvas is currently at are shared with it
+    CanvasHistoryItem currentSnapshot;
+    m_canvasHistory.currentHistory(currentSnapshot);
+
+    CanvasHistoryItem canvasHistoryItem;
+    for(int i = 0; i < m_canvasLayers.size(); i++)
     {
-        m_pClipboardPixels->setClipboard(m_beforeEffectsClipboard);
-        m_beforeEffectsClipboard.m_clipboardImage = QImage();
-        m_beforeEffectsClipboard.m_pixels.clear();
+        TiledCanvasLayer tiledLayer;
+        tiledLayer.m_info = m_canvasLayers[i].m_info;
+        if(!m_canvasLayers[i].m_undecodedImage.isNull())
+        {
+            tiledLayer.m_image = m_canvasLayers[i].m_undecodedImage;
+        }
+        else if(m_tiledLayerCache.contains(m_canvasLayers[i].m_image.cacheKey()))
+        {
+            const TiledLayerCacheItem cached = m_tiledLayerCache.value(m_canvasLayers[i].m_image.cacheKey());
+            tiledLayer.m_image = cached.m_editedRect.isEmpty() ? cached.m_tiles :
+                                    TiledImage::fromImage(m_canvasLayers[i].m_image, cached.m_tiles, cached.m_editedRect);
+        }
+        else
+        {
+            tiledLayer.m_image = TiledImage::fromImage(m_canvasLayers[i].m_image,
+                                                       i < currentSnapshot.m_layers.size() ? currentSnapshot.m_layers[i].m_image : TiledImage());
+        }
+        canvasHistoryItem.m_layers.push_back(tiledLayer);
     }
+    canvasHistoryItem.m_clipboard = m_pClipboardPixels->getClipboard();
+    return canvasHistoryItem;
 }
 
-QImage Canvas::getImageCopy()
-{
-    return m_canvasLayers[m_selectedLayer].m_image;
+void Canvas::decodeLayer(const int& index)
+{
+    if(index < 0 || index >= m_canvasLayers.size())
+    {
+        return;
+    }
+
+    CanvasLayer& canvasLayer = m_canvasLayers[index];
+    if(!canvasLayer.m_undecodedImage.isNull())
+    {
+        canvasLayer.m_image = canvasLayer.m_undecodedImage.toImage();
+        m_tiledLayerCache.insert(canvasLayer.m_image.cacheKey(), {canvasLayer.m_undecodedImage, QRect()});
+        canvasLayer.m_undecodedImage = TiledImage();
+    }
 }
 
-Tool Canvas::currentTool()
+void Canvas::recordHistory()
 {
-    return m_tool;
+    m_changeCount++;
+    const CanvasHistoryItem snapshot = getSnapshot();
+    m_canvasHistory.recordHistory(snapshot);
+    cacheTiledLayers(snapshot);
+    emit historyMemoryChange(m_canvasHistory.memoryUsage());
 }
 
-CanvasHistoryItem Canvas::getSnapshot()
+void Canvas::cacheTiledLayers(const CanvasHistoryItem& snapshot)
 {
-    CanvasHistoryItem canvasHistoryItem;
-    canvasHistoryItem.m_layers = m_canvasLayers;
-    canvasHistoryItem.m_clipboard = m_pClipboardPixels->getClipboard();
-    return canvasHistoryItem;
+    //Only the layers as they are now, so tiles dropped from history arent kept alive here
+    m_tiledLayerCache.clear();
+    for(int i = 0; i < m_canvasLayers.size() && i < snapshot.m_layers.size(); i++)
+    {
+        if(!m_canvasLayers[i].m_image.isNull())
+        {
+            m_tiledLayerCache.insert(m_canvasLayers[i].m_image.cacheKey(), {snapshot.m_layers[i].m_image, QRect()});
+        }
+    }
 }
 
 void Canvas::resizeEvent(QResizeEvent *event)
@@ -1443,7 +1690,7 @@ void Canvas::resizeEvent(QResizeEvent *event)
     update();
 }
 
-void Canvas::paintEvent(QPaintEvent*)
+void Canvas::paintEvent(QPaintEvent* paintEvent)
 {
     //Setup painter
     QPainter painter(this);
@@ -1453,16 +1700,48 @@ void Canvas::paintEvent(QPaintEvent*)
     painter.scale(m_zoomFactor, m_zoomFactor);
     painter.translate(-m_center);
 
-    //Switch out transparent pixels for grey-white pattern
-    painter.drawImage(m_panOffsetX, m_panOffsetY, m_canvasBackgroundImage);
-
-    //Draw current layers
-    for(CanvasLayer& canvasLayer : m_canvasLayers)
+    //Only composite the part of the canvas thats on screen & being repainted - the rest is culled before any drawing
+    const QRect exposedRect = getWidgetRectOnCanvas(paintEvent->rect().intersected(rect()), m_center, m_zoomFactor, m_panOffsetX, m_panOffsetY)
+                                .intersected(QRect(0, 0, m_canvasWidth, m_canvasHeight));
+    if(!exposedRect.isEmpty())
     {
-        if(canvasLayer.m_info.m_enabled)
+        //Mip levels can spill just past the canvas edge
+        painter.save();
+        painter.setClipRect(QRect(0, 0, m_canvasWidth, m_canvasHeight).translated(m_panOffsetX, m_panOffsetY));
+
+        //Draw current layers - background & layers below the selected layer, selected layer, layers above it
+        const QPoint panOffset = QPoint(m_panOffsetX, m_panOffsetY);
+        m_layerCompositor.update(m_canvasLayers, m_selectedLayer, QSize(m_canvasWidth, m_canvasHeight));
+        m_layerCompositor.drawBelowSelectedLayer(painter, exposedRect, m_zoomFactor, panOffset);
+        if((int)m_selectedLayer < m_canvasLayers.size() && m_canvasLayers[m_selectedLayer].m_info.m_enabled)
         {
-            painter.drawImage(m_panOffsetX, m_panOffsetY, canvasLayer.m_image);
+            if(m_layerEffect)
+            {
+                requestEffectPreview();
+
+                //Until a frame covering the exposed area is ready, the layer shows through as it was before effects
+                const QRect previewRectOnPainter = m_effectPreviewRect.translated(m_panOffsetX, m_panOffsetY);
+                if(!m_effectPreviewRect.contains(exposedRect))
+                {
+                    painter.save();
+                    painter.setClipRegion(QRegion(QRect(0, 0, m_canvasWidth, m_canvasHeight).translated(m_panOffsetX, m_panOffsetY))
+                                            .subtracted(QRegion(previewRectOnPainter)), Qt::IntersectClip);
+                    LayerCompositor::drawCanvasImage(painter, m_canvasLayers[m_selectedLayer].m_image, m_selectedLayerMips, exposedRect, m_zoomFactor, panOffset);
+                    painter.restore();
+                }
+                if(!m_effectPreviewImage.isNull())
+                {
+                    painter.drawImage(QRectF(previewRectOnPainter), m_effectPreviewImage);
+                }
+            }
+            else
+            {
+                LayerCompositor::drawCanvasImage(painter, m_canvasLayers[m_selectedLayer].m_image, m_selectedLayerMips, exposedRect, m_zoomFactor, panOffset);
+            }
         }
+        m_layerCompositor.drawAboveSelectedLayer(painter, exposedRect, m_zoomFactor, panOffset);
+
+        painter.restore();
     }
 
     //Draw selection tool
@@ -1516,6 +1795,7 @@ void Canvas::showEvent(QShowEvent *)
     m_pParent->setLayers(getLayerInfoList(m_canvasLayers), m_selectedLayer);
 
     emit canvasSizeChange(m_canvasWidth, m_canvasHeight);
+    emit historyMemoryChange(m_canvasHistory.memoryUsage());
     emit selectionAreaResize(0,0);
 }
 
@@ -1535,7 +1815,8 @@ QPoint getPositionRelativeCenterdAndZoomedCanvas(QPoint globalPos, QPoint& cente
     return pos.toPoint();
 }
 
-void paintBrush(QImage& canvas, const uint x, const uint y, const QColor col, const uint widthHeight, const BrushShape brushShape)
+//Returns the area painted (empty if nothing was)
+QRect paintBrush(QImage& canvas, const uint x, const uint y, const QColor col, const uint widthHeight, const BrushShape brushShape)
 {
     if(x <= (uint)canvas.width() && y <= (uint)canvas.height())
     {
@@ -1564,88 +1845,17 @@ void paintBrush(QImage& canvas, const uint x, const uint y, const QColor col, co
         {
             painter.fillRect(rect, col);
         }
-    }
-}
-
-void spreadSelectSimilarColor(QImage& image, QVector<QVector<bool>>& selectedPixels, QPoint startPixel, int sensitivty)
-{
-    if(startPixel.x() > image.width() || startPixel.x() < 0 || startPixel.y() > image.height() || startPixel.y() < 0)
-        return;
-
-    const QColor colorToSpreadOver = image.pixelColor(startPixel);
-
-    std::stack<QPoint> stack;
-    stack.push(startPixel);
-
-    while (stack.size() > 0)
-    {
-        QPoint p = stack.top();
-        stack.pop();
-        const int x = p.x();
-        const int y = p.y();
-        if (y < 0 || y >= image.height() || x < 0 || x >= image.width())
-            continue;
-
-        const QColor pixelColor = image.pixelColor(x,y);
-        if (selectedPixels[x][y] == false &&
-            pixelColor.red() <= colorToSpreadOver.red() + sensitivty && pixelColor.red() >= colorToSpreadOver.red() - sensitivty &&
-            pixelColor.green() <= colorToSpreadOver.green() + sensitivty && pixelColor.green() >= colorToSpreadOver.green() - sensitivty &&
-            pixelColor.blue() <= colorToSpreadOver.blue() + sensitivty && pixelColor.blue() >= colorToSpreadOver.blue() - sensitivty &&
-            pixelColor.alpha() <= colorToSpreadOver.alpha() + sensitivty && pixelColor.alpha() >= colorToSpreadOver.alpha() - sensitivty
-            )
-        {
-            selectedPixels[x][y] = true;
-            stack.push(QPoint(x + 1, y));
-            stack.push(QPoint(x - 1, y));
-            stack.push(QPoint(x, y + 1));
-            stack.push(QPoint(x, y - 1));
-        }
-    }
-}
-
-void floodFillOnSimilar(QImage &image, QColor newColor, int startX, int startY, int sensitivity)
-{
-    if(startX < image.width() && startX > -1 && startY < image.height() && startY > -1)
-    {
-        const QColor originalPixelColor = QColor(image.pixel(startX, startY));
-
-        std::stack<QPoint> stack;
-        stack.push(QPoint(startX,startY));
-
-        while (stack.size() > 0)
-        {
-            QPoint p = stack.top();
-            stack.pop();
-            const int x = p.x();
-            const int y = p.y();
-            if (y < 0 || y >= image.height() || x < 0 || x >= image.width())
-                continue;
 
-            const QColor pixelColor = image.pixelColor(x,y);
-            if (
-                //Check pixel color in sensitivity range
-                pixelColor.red() <= originalPixelColor.red() + sensitivity && pixelColor.red() >= originalPixelColor.red() - sensitivity &&
-                pixelColor.green() <= originalPixelColor.green() + sensitivity && pixelColor.green() >= originalPixelColor.green() - sensitivity &&
-                pixelColor.blue() <= originalPixelColor.blue() + sensitivity && pixelColor.blue() >= originalPixelColor.blue() - sensitivity &&
-
-                //Check not excat same color
-                pixelColor != newColor
-                    )
-            {
-                //Switch color
-                image.setPixelColor(x, y, newColor);
-
-                stack.push(QPoint(x + 1, y));
-                stack.push(QPoint(x - 1, y));
-                stack.push(QPoint(x, y + 1));
-                stack.push(QPoint(x, y - 1));
-            }
-        }
+        //Ellipse pen is drawn half outside rect
+        return rect.adjusted(-1, -1, 1, 1).intersected(canvas.rect());
     }
+    return QRect();
 }
 
 void Canvas::mousePressEvent(QMouseEvent *mouseEvent)
 {
+    waitForLayerEffect();
+
     if(mouseEvent->button() == Qt::MiddleButton)
     {
         m_bMiddleMouseDown = true;
@@ -1667,7 +1877,7 @@ void Canvas::mousePressEvent(QMouseEvent *mouseEvent)
         QPainter painter(&m_canvasLayers[m_selectedLayer].m_image);
         if(m_pClipboardPixels->dumpImage(painter))
         {
-            m_canvasHistory.recordHistory(getSnapshot());
+            recordHistory();
         }
         update();
     }
@@ -1686,13 +1896,13 @@ void Canvas::mousePressEvent(QMouseEvent *mouseEvent)
 
     if(m_tool == TOOL_PAINT)
     {
-        paintBrush(m_canvasLayers[m_selectedLayer].m_image, mouseLocation.x(), mouseLocation.y(), m_pParent->getSelectedColor(), m_pParent->getBrushSize(), m_pParent->getCurrentBrushShape());
-        update();
+        const qint64 cacheKeyBeforeEdit = m_canvasLayers[m_selectedLayer].m_image.cacheKey();
+        onSelectedLayerEdited(cacheKeyBeforeEdit, paintBrush(m_canvasLayers[m_selectedLayer].m_image, mouseLocation.x(), mouseLocation.y(), m_pParent->getSelectedColor(), m_pParent->getBrushSize(), m_pParent->getCurrentBrushShape()));
     }
     else if(m_tool == TOOL_ERASER)
     {
-        paintBrush(m_canvasLayers[m_selectedLayer].m_image, mouseLocation.x(), mouseLocation.y(), Qt::transparent, m_pParent->getBrushSize(), m_pParent->getCurrentBrushShape());
-        update();
+        const qint64 cacheKeyBeforeEdit = m_canvasLayers[m_selectedLayer].m_image.cacheKey();
+        onSelectedLayerEdited(cacheKeyBeforeEdit, paintBrush(m_canvasLayers[m_selectedLayer].m_image, mouseLocation.x(), mouseLocation.y(), Qt::transparent, m_pParent->getBrushSize(), m_pParent->getCurrentBrushShape()));
     }
     else if(m_tool == TOOL_SELECT)
     {
@@ -1711,21 +1921,22 @@ void Canvas::mousePressEvent(QMouseEvent *mouseEvent)
             m_pClipboardPixels->reset();
         }
 
-        QVector<QVector<bool>> newSelectedPixels = QVector<QVector<bool>>(m_canvasWidth, QVector<bool>(m_canvasHeight, false));
-        spreadSelectSimilarColor(m_canvasLayers[m_selectedLayer].m_image, newSelectedPixels, mouseLocation, m_pParent->getSpreadSensitivity());
+        const QBitArray newSelectedPixels = FloodFill::spreadSelectSimilarColor(m_canvasLayers[m_selectedLayer].m_image, mouseLocation, m_pParent->getSpreadSensitivity());
         m_pClipboardPixels->addPixels(m_canvasLayers[m_selectedLayer].m_image, newSelectedPixels);
 
-        m_canvasHistory.recordHistory(getSnapshot());
+        recordHistory();
 
         update();
     }
     else if(m_tool == TOOL_BUCKET)
     {
-        floodFillOnSimilar(m_canvasLayers[m_selectedLayer].m_image, m_pParent->getSelectedColor(), mouseLocation.x(), mouseLocation.y(), m_pParent->getSpreadSensitivity());
+        const qint64 cacheKeyBeforeEdit = m_canvasLayers[m_selectedLayer].m_image.cacheKey();
+        const QRect filledRect = FloodFill::floodFillOnSimilar(m_canvasLayers[m_selectedLayer].m_image, m_pParent->getSelectedColor(), mouseLocation.x(), mouseLocation.y(), m_pParent->getSpreadSensitivity());
 
-        m_canvasHistory.recordHistory(getSnapshot());
+        //Before recording, so the snapshot only re-tiles filledRect
+        onSelectedLayerEdited(cacheKeyBeforeEdit, filledRect);
 
-        update();
+        recordHistory();
     }
     else if(m_tool == TOOL_COLOR_PICKER)
     {
@@ -1759,7 +1970,7 @@ void Canvas::mouseReleaseEvent(QMouseEvent *releaseEvent)
     if(m_tool == TOOL_SELECT)
     {
         m_pClipboardPixels->addPixels(m_canvasLayers[m_selectedLayer].m_image, m_selectionTool); //Assumes there is a selected layer
-        m_canvasHistory.recordHistory(getSnapshot());
+        recordHistory();
 
         //Reset selection rectangle tool
         m_selectionTool->setGeometry(QRect(m_selectionToolOrigin, QSize()));
@@ -1774,20 +1985,20 @@ void Canvas::mouseReleaseEvent(QMouseEvent *releaseEvent)
     }
     else if (m_tool == TOOL_PAINT || m_tool == TOOL_ERASER)
     {
-        m_canvasHistory.recordHistory(getSnapshot());
+        recordHistory();
     }   
     else if(m_tool == TOOL_DRAG || m_tool == TOOL_ROTATE)
     {
         if(m_pClipboardPixels->checkFinishOperation())
         {
-            m_canvasHistory.recordHistory(getSnapshot());
+            recordHistory();
         }
     }
     else if(m_tool == TOOL_SHAPE)
     {
         if(m_pClipboardPixels->clipboardActive())
         {
-            m_canvasHistory.recordHistory(getSnapshot());
+            recordHistory();
         }
     }
 }
@@ -1828,13 +2039,13 @@ void Canvas::mouseMoveEvent(QMouseEvent *event)
     {
         if(m_tool == TOOL_PAINT)
         {
-            paintBrush(m_canvasLayers[m_selectedLayer].m_image, mouseLocation.x(), mouseLocation.y(), m_pParent->getSelectedColor(), m_pParent->getBrushSize(), m_pParent->getCurrentBrushShape());
-            update();
+            const qint64 cacheKeyBeforeEdit = m_canvasLayers[m_selectedLayer].m_image.cacheKey();
+            onSelectedLayerEdited(cacheKeyBeforeEdit, paintBrush(m_canvasLayers[m_selectedLayer].m_image, mouseLocation.x(), mouseLocation.y(), m_pParent->getSelectedColor(), m_pParent->getBrushSize(), m_pParent->getCurrentBrushShape()));
         }
         else if(m_tool == TOOL_ERASER)
         {
-            paintBrush(m_canvasLayers[m_selectedLayer].m_image, mouseLocation.x(), mouseLocation.y(), Qt::transparent, m_pParent->getBrushSize(), m_pParent->getCurrentBrushShape());
-            update();
+            const qint64 cacheKeyBeforeEdit = m_canvasLayers[m_selectedLayer].m_image.cacheKey();
+            onSelectedLayerEdited(cacheKeyBeforeEdit, paintBrush(m_canvasLayers[m_selectedLayer].m_image, mouseLocation.x(), mouseLocation.y(), Qt::transparent, m_pParent->getBrushSize(), m_pParent->getCurrentBrushShape()));
         }
         else if(m_tool == TOOL_SELECT)
         {
@@ -1964,6 +2175,12 @@ void Canvas::mouseMoveEvent(QMouseEvent *event)
 
 QImage Canvas::getCanvasImageBeforeEffects()
 {
+    //Effects on selected pixels go straight onto the layer, so stop previewing any whole layer effect
+    if(m_layerEffect)
+    {
+        clearLayerEffect();
+    }
+
     if(m_beforeEffectsImage == QImage())
     {
         m_beforeEffectsImage = m_canvasLayers[m_selectedLayer].m_image; //Assumes there is a selected layer
@@ -1973,6 +2190,11 @@ QImage Canvas::getCanvasImageBeforeEffects()
 
 Clipboard Canvas::getClipboardBeforeEffects()
 {
+    if(m_layerEffect)
+    {
+        clearLayerEffect();
+    }
+
     if(m_beforeEffectsClipboard.m_clipboardImage == QImage())
     {
         m_beforeEffectsClipboard = m_pClipboardPixels->getClipboard();
@@ -1980,6 +2202,30 @@ Clipboard Canvas::getClipboardBeforeEffects()
     return m_beforeEffectsClipboard;
 }
 
+void Canvas::onSelectedLayerEdited(const qint64& cacheKeyBeforeEdit, const QRect& editedRect)
+{
+    const qint64 cacheKey = m_canvasLayers[m_selectedLayer].m_image.cacheKey();
+    m_selectedLayerMips.imageEdited(cacheKeyBeforeEdit, cacheKey, editedRect);
+
+    //Next snapshot only re-tiles the edited tiles
+    if(m_tiledLayerCache.contains(cacheKeyBeforeEdit))
+    {
+        TiledLayerCacheItem cached = m_tiledLayerCache.take(cacheKeyBeforeEdit);
+        cached.m_editedRect |= editedRect;
+        m_tiledLayerCache.insert(cacheKey, cached);
+    }
+
+    updateCanvasRect(editedRect);
+}
+
+void Canvas::updateCanvasRect(const QRect& canvasRect)
+{
+    if(!canvasRect.isEmpty())
+    {
+        update(getCanvasRectOnWidget(canvasRect, m_center, m_zoomFactor, m_panOffsetX, m_panOffsetY));
+    }
+}
+
 void Canvas::updateCenter()
 {
     m_center = QPoint(geometry().width() / 2, geometry().height() / 2);
@@ -2076,14 +2322,15 @@ void PaintableClipboard::generateClipboardSteal(QImage &canvas)
     m_clipboardImage = QImage(QSize(canvas.width(), canvas.height()), QImage::Format_ARGB32);
     m_clipboardImage.fill(Qt::transparent);
 
-    const QVector<QPoint> pixels = m_pixels;
-    for(const QPoint& p: pixels)
+    PixelKernels::ensureArgb32(canvas);
+    m_pixels.forEachSpanInRect(canvas.rect(), [&](const int y, const int left, const int right)-> void
     {
-        m_clipboardImage.setPixelColor(p.x(), p.y(), canvas.pixelColor(p.x(),p.y()));
-        canvas.setPixelColor(p.x(), p.y(), Qt::transparent);
-    }
+        QRgb* canvasLine = reinterpret_cast<QRgb*>(canvas.scanLine(y));
+        QRgb* clipboardLine = reinterpret_cast<QRgb*>(m_clipboardImage.scanLine(y));
+        std::copy(canvasLine + left, canvasLine + right + 1, clipboardLine + left);
+        std::fill(canvasLine + left, canvasLine + right + 1, qRgba(0, 0, 0, 0));
+    });
 
-    m_backgroundImage = genTransparentPixelsBackground(m_clipboardImage.width(), m_clipboardImage.height());
     updateDimensionsRect();
     update();
 }
@@ -2091,10 +2338,10 @@ void PaintableClipboard::generateClipboardSteal(QImage &canvas)
 void PaintableClipboard::setClipboard(Clipboard clipboard)
 {
     m_clipboardImage = clipboard.m_clipboardImage;
-    m_backgroundImage = genTransparentPixelsBackground(m_clipboardImage.width(), m_clipboardImage.height());
     m_pixels = clipboard.m_pixels;
     m_dragX = clipboard.m_dragX;
     m_dragY = clipboard.m_dragY;
+    updateHighlightLookup();
     updatePixelBorders();
     updateDimensionsRect();
     update();
@@ -2118,19 +2365,9 @@ bool PaintableClipboard::clipboardActive()
 void PaintableClipboard::setImage(QImage& image)
 {
     m_clipboardImage = image;
-    m_backgroundImage = genTransparentPixelsBackground(m_clipboardImage.width(), m_clipboardImage.height());
 
-    m_pixels.clear();
-    for(int x = 0; x < image.width(); x++)
-    {
-        for(int y = 0; y < image.height(); y++)
-        {
-            if(image.pixelColor(x,y).alpha() > 0)
-            {
-                m_pixels.push_back(QPoint(x,y));
-            }
-        }
-    }
+    m_pixels = SelectionMask::fromImageAlpha(image);
+    updateHighlightLookup();
     updatePixelBorders();
     updateDimensionsRect();
     update();
@@ -2156,15 +2393,15 @@ bool PaintableClipboard::dumpImage(QPainter &painter)
 
     //Draw transparent part of clipboard
     painter.setCompositionMode (QPainter::CompositionMode_Clear);
-    for(QPoint& p : m_pixels)
+    m_pixels.forEachPixel([&](const int x, const int y)-> void
     {
-        if(p.x() > 0 && p.x() < (int)m_clipboardImage.width() &&
-           p.y()> 0 && p.y() < (int)m_clipboardImage.height() &&
-           m_clipboardImage.pixelColor(p.x(), p.y()).alpha() == 0)
+        if(x > 0 && x < (int)m_clipboardImage.width() &&
+           y > 0 && y < (int)m_clipboardImage.height() &&
+           m_clipboardImage.pixelColor(x, y).alpha() == 0)
         {
-            painter.fillRect(QRect(p.x() + m_dragX, p.y() + m_dragY, 1, 1), Qt::transparent);
+            painter.fillRect(QRect(x + m_dragX, y + m_dragY, 1, 1), Qt::transparent);
         }
-    }
+    });
 
     reset();
     return true;
@@ -2172,74 +2409,115 @@ bool PaintableClipboard::dumpImage(QPainter &painter)
 
 bool PaintableClipboard::isHighlighted(const int& x, const int& y)
 {
-    for(QPoint& p : m_pixels)
+    //m_pixels are relative to the drag offset, the lookup is built from m_pixels
+    const int pixelX = x - m_dragX;
+    const int pixelY = y - m_dragY;
+
+    if(!m_highlightLookupRect.contains(pixelX, pixelY))
     {
-        if(p.x() + m_dragX == x && p.y() + m_dragY == y)
-        {
-            return true;
-        }
+        return false;
     }
-    return false;
+
+    return m_highlightLookup.testBit((pixelY - m_highlightLookupRect.top()) * m_highlightLookupRect.width() + pixelX - m_highlightLookupRect.left());
+}
+
+void PaintableClipboard::updateHighlightLookup()
+{
+    //Bitmap of m_pixels over their bounding rect, so isHighlighted doesnt have to search the selection
+    m_highlightLookupRect = m_pixels.boundingRect();
+    m_highlightLookup = QBitArray(m_highlightLookupRect.isValid() ? m_highlightLookupRect.width() * m_highlightLookupRect.height() : 0);
+
+    const int left = m_highlightLookupRect.left();
+    const int top = m_highlightLookupRect.top();
+    const int width = m_highlightLookupRect.width();
+    m_pixels.forEachSpan([&](const int y, const int spanLeft, const int spanRight)-> void
+    {
+        const int rowStart = (y - top) * width - left;
+        m_highlightLookup.fill(true, rowStart + spanLeft, rowStart + spanRight + 1);
+    });
 }
 
 bool PaintableClipboard::containsPixels()
 {
-    return m_pixels.size() > 0;
+    return !m_pixels.isEmpty();
 }
 
-QVector<QPoint> PaintableClipboard::getPixels()
+const SelectionMask& PaintableClipboard::getPixels()
 {
     return m_pixels;
 }
 
-QVector<QPoint> PaintableClipboard::getPixelsOffset()
+SelectionMask PaintableClipboard::getPixelsOffset()
 {
-    QVector<QPoint> pixels = m_pixels;
-    for(QPoint& p : pixels)
-    {
-        p.setX(p.x() + m_dragX);
-        p.setY(p.y() + m_dragY);
-    }
-    return pixels;
+    return m_pixels.translated(m_dragX, m_dragY);
 }
 
 void PaintableClipboard::updatePixelBorders()
 {
-    //2D vectorize selected pixels for quicker outline drawing
-    QVector<QVector<bool>> selectedPixelsVector = listTo2dVector(m_pixels,
-                                                                 m_clipboardImage != QImage() ? m_clipboardImage.width() + 1 : m_parentCanvasWidth + 1,
-                                                                 m_clipboardImage != QImage() ? m_clipboardImage.height() + 1 : m_parentCanvasHeight + 1);
+    //Selection changed, so the overlay needs rebuilding too
+    m_bSelectionOverlayDirty = true;
 
-    m_pixelBorders.clear();
-    for(QPoint& p : m_pixels)
+    m_pixelBorders = m_pixels.outlinePath();
+}
+
+void PaintableClipboard::updateSelectionOverlay()
+{
+    if(!m_bSelectionOverlayDirty && m_selectionOverlayClipboardKey == m_clipboardImage.cacheKey())
     {
-        const int x = p.x();
-        const int y = p.y();
+        return;
+    }
+    m_bSelectionOverlayDirty = false;
+    m_selectionOverlayClipboardKey = m_clipboardImage.cacheKey();
 
-        //border right
-        if(!selectedPixelsVector[x+1][y])
-        {
-            m_pixelBorders.push_back(QPair<QPoint, QPoint>(QPoint(x + 1, y ), QPoint(x + 1, y + 1)));
-        }
+    m_selectionOverlayRect = m_pixels.boundingRect();
+    if(m_selectionOverlayRect.isEmpty())
+    {
+        m_selectionOverlayImage = QImage();
+        return;
+    }
 
-        //border left
-        if(x == 0 || !selectedPixelsVector[x-1][y])
-        {
-            m_pixelBorders.push_back(QPair<QPoint, QPoint>(QPoint(x, y), QPoint(x, y + 1)));
-        }
+    m_selectionOverlayImage = QImage(m_selectionOverlayRect.size(), QImage::Format_ARGB32_Premultiplied);
+    m_selectionOverlayImage.fill(Qt::transparent);
 
-        //border bottom
-        if(!selectedPixelsVector[x][y+1])
+    //Overlay colors, premultiplied. Transparent clipboard pixels show the checkerboard (same
+    //  colors & parity as LayerCompositor::transparentPixelsBrush) under the highlight, everything else just the highlight
+    const QRgb highlight = qPremultiply(Constants::SelectionAreaColor.rgba());
+    const int highlightAlpha = qAlpha(highlight);
+    const auto highlightOver = [&](const QRgb below)-> QRgb
+    {
+        return qRgba(qRed(highlight) + qRed(below) * (255 - highlightAlpha) / 255,
+                     qGreen(highlight) + qGreen(below) * (255 - highlightAlpha) / 255,
+                     qBlue(highlight) + qBlue(below) * (255 - highlightAlpha) / 255,
+                     highlightAlpha + qAlpha(below) * (255 - highlightAlpha) / 255);
+    };
+    const QRgb highlightOverChecker[2] = {highlightOver(LayerCompositor::TransparentWhite.rgba()), highlightOver(LayerCompositor::TransparentGrey.rgba())};
+
+    const bool hasClipboardImage = m_clipboardImage != QImage();
+    const QRect clipboardImageRect = m_clipboardImage.rect();
+    const int overlayLeft = m_selectionOverlayRect.left();
+    const int overlayTop = m_selectionOverlayRect.top();
+    m_pixels.forEachSpan([&](const int y, const int left, const int right)-> void
+    {
+        QRgb* overlayLine = reinterpret_cast<QRgb*>(m_selectionOverlayImage.scanLine(y - overlayTop)) - overlayLeft;
+        for(int x = left; x <= right; x++)
         {
-            m_pixelBorders.push_back(QPair<QPoint, QPoint>(QPoint(x, y + 1.0), QPoint(x + 1.0, y + 1.0)));
+            overlayLine[x] = highlight;
         }
 
-        //border top
-        if(y == 0 || !selectedPixelsVector[x][y-1])
+        if(hasClipboardImage && y >= 0 && y < clipboardImageRect.height())
         {
-            m_pixelBorders.push_back(QPair<QPoint, QPoint>(QPoint(x, y), QPoint(x + 1.0, y)));
+            const QRgb* clipboardLine = reinterpret_cast<const QRgb*>(m_clipboardImage.constScanLine(y));
+            const int imageLeft = qMax(left, 0);
+            const int imageRight = qMin(right, clipboardImageRect.width() - 1);
+            for(int x = imageLeft; x <= imageRight; x++)
+            {
+                if(qAlpha(clipboardLine[x]) == 0)
+                {
+                    overlayLine[x] = highlightOverChecker[(x + y) & 1];
+                }
+            }
         }
-    }
+    });
 }
 
 bool PaintableClipboard::checkStartNormalDragging(QImage &canvas, QPoint mouseLocation)
@@ -2262,39 +2540,7 @@ bool PaintableClipboard::checkStartNormalDragging(QImage &canvas, QPoint mouseLo
 
 void PaintableClipboard::operateOnSelectedPixels(std::function<void (int, int)> func)
 {
-    for(QPoint& p : m_pixels)
-    {
-        func(p.x(), p.y());
-    }
-}
-
-QRect getPixelsDimensions(QVector<QPoint>& pixels)
-{
-    QRect returnRect = QRect();
-    QList<bool> alreadySet = {false, false};
-    for(QPoint& p : pixels)
-    {
-        if(!alreadySet[0] || returnRect.x() > p.x())
-        {
-            returnRect.setX(p.x());
-            alreadySet[0] = true;
-        }
-        if(!alreadySet[1] || returnRect.y() > p.y())
-        {
-            returnRect.setY(p.y());
-            alreadySet[1] = true;
-        }
-        if(returnRect.right() < p.x())
-        {
-            returnRect.setRight(p.x());
-        }
-        if(returnRect.bottom() < p.y())
-        {
-            returnRect.setBottom(p.y());
-        }
-    }
-
-    return returnRect;
+    m_pixels.forEachPixel(func);
 }
 
 void PaintableClipboard::addImageToActiveClipboard(QImage& newPixelsImage)
@@ -2304,18 +2550,14 @@ void PaintableClipboard::addImageToActiveClipboard(QImage& newPixelsImage)
     int oldDragY = m_dragY;
 
     //Get new m_drags
-    QRect dimensionsRect = getPixelsDimensions(m_pixels);
+    QRect dimensionsRect = m_pixels.boundingRect();
     m_dragX = dimensionsRect.left() < 0 ? dimensionsRect.left() : 0;
     m_dragY = dimensionsRect.top() < 0 ? dimensionsRect.top() : 0;
 
     //Offset pixels based on new m_drags
     if(m_dragX != 0 || m_dragY != 0)
     {
-        for(QPoint& p : m_pixels)
-        {
-            p.setX(p.x() - m_dragX);
-            p.setY(p.y() - m_dragY);
-        }
+        m_pixels = m_pixels.translated(-m_dragX, -m_dragY);
     }
 
     //Create new clipboard image
@@ -2332,8 +2574,8 @@ void PaintableClipboard::addImageToActiveClipboard(QImage& newPixelsImage)
 
     //Set new clipboard
     m_clipboardImage = newClipboardImage;
-    m_backgroundImage = genTransparentPixelsBackground(m_clipboardImage.width(), m_clipboardImage.height());
 
+    updateHighlightLookup();
     updatePixelBorders();
     updateDimensionsRect();
     update();
@@ -2351,20 +2593,15 @@ void PaintableClipboard::addPixels(QImage& canvas, QRubberBand* newSelectionArea
     const int selectionTop = geometry.top() >= 0 ? geometry.top() : 0;
     const int selectionBottom = geometry.bottom() <= canvas.height() ? geometry.bottom() : canvas.height();
 
+    const SelectionMask selectionArea = selectionRight > selectionLeft && selectionBottom > selectionTop ?
+                SelectionMask::fromRect(QRect(selectionLeft, selectionTop, selectionRight - selectionLeft, selectionBottom - selectionTop)) : SelectionMask();
+
     //If theres no active clipboard (no dragging or re-shaping has been done) then just add pixels
     if(!clipboardActive())
     {
-        for (int x = selectionLeft; x < selectionRight; x++)
-        {
-            for (int y = selectionTop; y < selectionBottom; y++)
-            {
-                m_pixels.push_back(QPoint(x,y));
-            }
-        }
-
-        //Remove duplicates
-        m_pixels.erase(std::unique(m_pixels.begin(), m_pixels.end()), m_pixels.end());
+        m_pixels = m_pixels.united(selectionArea);
 
+        updateHighlightLookup();
         updatePixelBorders();
         updateDimensionsRect();
         update();
@@ -2378,12 +2615,11 @@ void PaintableClipboard::addPixels(QImage& canvas, QRubberBand* newSelectionArea
     newPixelsImage.fill(Qt::transparent);
 
     //Gather all pixels in position relative to parent canvas
-    m_pixels = getPixelsOffset();
+    m_pixels = getPixelsOffset().united(selectionArea);
     for (int x = selectionLeft; x < selectionRight; x++)
     {
         for (int y = selectionTop; y < selectionBottom; y++)
         {
-            m_pixels.push_back(QPoint(x,y));
             newPixelsImage.setPixelColor(x, y, canvas.pixelColor(x,y));
 
             //Rip from canvas
@@ -2391,31 +2627,22 @@ void PaintableClipboard::addPixels(QImage& canvas, QRubberBand* newSelectionArea
         }
     }
 
-    //Remove duplicates
-    m_pixels.erase(std::unique(m_pixels.begin(), m_pixels.end()), m_pixels.end());
-
     addImageToActiveClipboard(newPixelsImage);
 }
 
-void PaintableClipboard::addPixels(QImage& canvas, QVector<QVector<bool>>& selectedPixels)
+void PaintableClipboard::addPixels(QImage& canvas, const QBitArray& selectedPixels)
 {
+    const int width = canvas.width();
+    const int height = canvas.height();
+
+    const SelectionMask newPixels = SelectionMask::fromBits(selectedPixels, width, height);
+
     //If theres no active clipboard (no dragging or re-shaping has been done) then just add pixels
     if(!clipboardActive())
     {
-        for(int x = 0; x < selectedPixels.size(); x++)
-        {
-            for(int y = 0; y < selectedPixels[x].size(); y++)
-            {
-                if(selectedPixels[x][y])
-                {
-                    m_pixels.push_back(QPoint(x,y));
-                }
-            }
-        }
-
-        //Remove duplicates
-        m_pixels.erase(std::unique(m_pixels.begin(), m_pixels.end()), m_pixels.end());
+        m_pixels = m_pixels.united(newPixels);
 
+        updateHighlightLookup();
         updatePixelBorders();
         updateDimensionsRect();
         update();
@@ -2425,29 +2652,19 @@ void PaintableClipboard::addPixels(QImage& canvas, QVector<QVector<bool>>& selec
 
     //Otherwise - create image from new pixels to add to existing clipboard:
 
-    QImage newPixelsImage = QImage(QSize(canvas.width(), canvas.height()), QImage::Format_ARGB32);
+    QImage newPixelsImage = QImage(QSize(width, height), QImage::Format_ARGB32);
     newPixelsImage.fill(Qt::transparent);
 
     //Gather all pixels in position relative to parent canvas
-    m_pixels = getPixelsOffset();
+    m_pixels = getPixelsOffset().united(newPixels);
 
-    for(int x = 0; x < selectedPixels.size(); x++)
+    newPixels.forEachPixel([&](const int x, const int y)-> void
     {
-        for(int y = 0; y < selectedPixels[x].size(); y++)
-        {
-            if(selectedPixels[x][y])
-            {
-                m_pixels.push_back(QPoint(x,y));
-                newPixelsImage.setPixelColor(x, y, canvas.pixelColor(x,y));
-
-                //Rip from canvas
-                canvas.setPixelColor(x, y, Qt::transparent);
-            }
-        }
-    }
+        newPixelsImage.setPixelColor(x, y, canvas.pixelColor(x,y));
 
-    //Remove duplicates
-    m_pixels.erase(std::unique(m_pixels.begin(), m_pixels.end()), m_pixels.end());
+        //Rip from canvas
+        canvas.setPixelColor(x, y, Qt::transparent);
+    });
 
     addImageToActiveClipboard(newPixelsImage);
 }
@@ -2543,12 +2760,15 @@ bool PaintableClipboard::checkFinishOperation()
 
 void PaintableClipboard::doNormalDragging(QPoint mouseLocation)
 {
+    const QRect previousDirtyRect = getDimensionsRectOnWidget();
+
     m_dragX += (mouseLocation.x() - m_previousDragPos.x());
     m_dragY += (mouseLocation.y() - m_previousDragPos.y());
 
     m_previousDragPos = mouseLocation;
 
-    update();
+    //Repaint where the clipboard was & where it is now
+    update(previousDirtyRect.united(getDimensionsRectOnWidget()));
 }
 
 QPointF getLocation(QRectF rect, DragNubblePos nubblePos)
@@ -2670,9 +2890,6 @@ void PaintableClipboard::doResizeDragScale()
     QImage clipboardImageTransparent = QImage(QSize(newWidth, newHeight), QImage::Format_ARGB32);
     clipboardImageTransparent.fill(Qt::transparent);
 
-    //Set background image to new size
-    m_backgroundImage = genTransparentPixelsBackground(newWidth, newHeight);
-
     //Scale
     QPainter clipboardPainter(&m_clipboardImage);
     clipboardPainter.drawImage(m_dimensionsRect, m_clipboardImageBeforeOperation, m_dimensionsRectBeforeOperation);
@@ -2682,21 +2899,8 @@ void PaintableClipboard::doResizeDragScale()
     tClipboardPainter.drawImage(m_dimensionsRect, m_clipboardImageBeforeOperationTransparent, m_dimensionsRectBeforeOperation);
 
     //Set new pixels based off scaled image
-    m_pixels.clear();
-    for(int x = 0; x < m_clipboardImage.width(); x++)
-    {
-        for(int y = 0; y < m_clipboardImage.height(); y++)
-        {
-            if(m_clipboardImage.pixelColor(x,y).alpha() > 0)
-            {
-                m_pixels.push_back(QPoint(x,y));
-            }
-            else if(clipboardImageTransparent.pixelColor(x,y).alpha() > 0)
-            {
-                m_pixels.push_back(QPoint(x,y));
-            }
-        }
-    }
+    m_pixels = SelectionMask::fromImageAlpha(m_clipboardImage).united(SelectionMask::fromImageAlpha(clipboardImageTransparent));
+    updateHighlightLookup();
     updatePixelBorders();
     updateDimensionsRect();
     update();
@@ -2758,7 +2962,6 @@ void PaintableClipboard::doRotateDrag(QPointF mouseLocation)
 
     //Create new clipboard image (to include overspill from rotating) - set background image to same dimensions
     m_clipboardImage = QImage(QSize(m_clipboardImageBeforeOperation.width() - xUnderRange + xOverRange, m_clipboardImageBeforeOperation.height() - yUnderRange + yOverRange), QImage::Format_ARGB32);
-    m_backgroundImage = genTransparentPixelsBackground(m_clipboardImage.width(), m_clipboardImage.height());
 
     //Paint rotated m_clipboardImageBeforeOperation onto m_clipboardImage
     m_clipboardImage.fill(Qt::transparent);
@@ -2777,21 +2980,8 @@ void PaintableClipboard::doRotateDrag(QPointF mouseLocation)
     transparentClipboardRotatePainter.end();
 
     //Get new pixels based on rotated images
-    m_pixels.clear();
-    for(int x = 0; x < m_clipboardImage.width(); x++)
-    {
-        for(int y = 0; y < m_clipboardImage.height(); y++)
-        {
-            if(m_clipboardImage.pixelColor(x, y).alpha() > 0)
-            {
-                m_pixels.push_back(QPoint(x,y));
-            }
-            else if(clipboardImageTransparent.pixelColor(x, y).alpha() > 0)
-            {
-                m_pixels.push_back(QPoint(x, y));
-            }
-        }
-    }
+    m_pixels = SelectionMask::fromImageAlpha(m_clipboardImage).united(SelectionMask::fromImageAlpha(clipboardImageTransparent));
+    updateHighlightLookup();
     updatePixelBorders();
     update();
 }
@@ -2803,23 +2993,23 @@ void PaintableClipboard::prepResizeOrRotateDrag()
 
     m_clipboardImageBeforeOperationTransparent = QImage(QSize(m_clipboardImageBeforeOperation.width(), m_clipboardImageBeforeOperation.height()), QImage::Format_ARGB32);
     m_clipboardImageBeforeOperationTransparent.fill(Qt::transparent);
-    for(QPoint& p : m_pixels)
+    m_pixels.forEachPixel([&](const int x, const int y)-> void
     {
-        if(m_clipboardImageBeforeOperation.pixelColor(p.x(), p.y()).alpha() == 0)
+        if(m_clipboardImageBeforeOperation.pixelColor(x, y).alpha() == 0)
         {
-            m_clipboardImageBeforeOperationTransparent.setPixelColor(p.x(), p.y(), Qt::black);
+            m_clipboardImageBeforeOperationTransparent.setPixelColor(x, y, Qt::black);
         }
-    }
+    });
 }
 
 void PaintableClipboard::reset()
 {
     m_clipboardImage = QImage();
-    m_backgroundImage = QImage();
     m_dragX = 0;
     m_dragY = 0;
     m_pixels.clear();
     m_dimensionsRect = QRect();
+    updateHighlightLookup();
     updatePixelBorders();
     update();
 }
@@ -2843,14 +3033,18 @@ void PaintableClipboard::updateParentPanOffset(const int &panOffsetX, const int
 
 void PaintableClipboard::onSwitchOutlineColor()
 {
+    //Nothing flashes without a selection
+    if(m_pixels.isEmpty())
+    {
+        return;
+    }
+
     m_bOutlineColorToggle = !m_bOutlineColorToggle;
-    update();
+    update(getDimensionsRectOnWidget());
 }
 
 void PaintableClipboard::paintEvent(QPaintEvent *paintEvent)
 {
-    Q_UNUSED(paintEvent);
-
     QPainter painter(this);
 
     const QPoint center = QPoint(geometry().width() / 2, geometry().height() / 2);
@@ -2861,37 +3055,35 @@ void PaintableClipboard::paintEvent(QPaintEvent *paintEvent)
     const int offsetX = m_parentPanOffsetX + m_dragX;
     const int offsetY = m_parentPanOffsetY + m_dragY;
 
+    //Part of the clipboard (in clipboard pixels) on screen & being repainted, nothing outside it is drawn
+    const QRect visibleRect = getWidgetRectOnCanvas(paintEvent->rect().intersected(rect()), center, m_parentZoom, offsetX, offsetY);
+
     //Draw clipboard
-    painter.drawImage(QRect(offsetX, offsetY, m_clipboardImage.width(), m_clipboardImage.height()), m_clipboardImage);
+    const QRect visibleImageRect = visibleRect.intersected(m_clipboardImage.rect());
+    if(!visibleImageRect.isEmpty())
+    {
+        painter.drawImage(visibleImageRect.translated(offsetX, offsetY), m_clipboardImage, visibleImageRect);
+    }
 
     //Draw transparent selected pixels & highlight overlay for selected pixels
-    for(QPoint& p : m_pixels)
+    updateSelectionOverlay();
+    const QRect visibleOverlayRect = visibleRect.intersected(m_selectionOverlayRect);
+    if(!visibleOverlayRect.isEmpty())
     {
-        const int x = p.x();
-        const int y = p.y();
-
-        if(m_clipboardImage != QImage())
-        {
-            if(m_clipboardImage.pixelColor(x, y).alpha() == 0)
-            {
-                painter.fillRect(QRect(x + offsetX, y + offsetY, 1, 1), m_backgroundImage.pixelColor(x, y));
-            }
-        }
-
-        painter.fillRect(QRect(x + offsetX, y + offsetY, 1, 1), Constants::SelectionAreaColor);
+        painter.drawImage(visibleOverlayRect.translated(offsetX, offsetY), m_selectionOverlayImage, visibleOverlayRect.translated(-m_selectionOverlayRect.topLeft()));
     }
 
     //Draw highlight outline
-    QPen selectionOutlinePen = QPen(m_bOutlineColorToggle ? Qt::black : Qt::white, 1/m_parentZoom);
+    //Cosmetic pen is always 1 screen pixel wide, and cheap to stroke compared to a scaled pen
+    QPen selectionOutlinePen = QPen(m_bOutlineColorToggle ? Qt::black : Qt::white, 1);
+    selectionOutlinePen.setCosmetic(true);
     painter.setPen(selectionOutlinePen);
-    const QPoint offset(offsetX, offsetY);
-    for(QPair<QPoint, QPoint>& line : m_pixelBorders)
-    {
-        painter.drawLine(line.first + offset, line.second + offset);
-    }
+    painter.translate(offsetX, offsetY);
+    painter.drawPath(m_pixelBorders);
+    painter.translate(-offsetX, -offsetY);
 
     //Draw nubbles that scale dimension of clipboard
-    if(m_pixels.size() > 0 && m_pParentCanvas->currentTool() == TOOL_DRAG)
+    if(!m_pixels.isEmpty() && m_pParentCanvas->currentTool() == TOOL_DRAG)
     {
         QRectF translatedDimensions = m_dimensionsRect.translated(offsetX, offsetY);
 
@@ -2905,18 +3097,36 @@ void PaintableClipboard::paintEvent(QPaintEvent *paintEvent)
 
 void PaintableClipboard::updateDimensionsRect()
 {
-    m_dimensionsRect = getPixelsDimensions(m_pixels);
+    m_dimensionsRect = m_pixels.boundingRect();
+}
+
+QRect PaintableClipboard::getDimensionsRectOnWidget()
+{
+    //Everything drawn is inside the dimensions rect, apart from the nubbles around its edge. Mid rotate drag the dimensions
+    //  rect is still the one before rotating (its the pivot), so the rotated pixels bounds are added
+    const QRect drawnRect = m_operationMode == RotateOperation ? m_dimensionsRect.united(m_pixels.boundingRect()) : m_dimensionsRect;
+    const QPoint center = QPoint(geometry().width() / 2, geometry().height() / 2);
+    return getCanvasRectOnWidget(drawnRect.translated(m_dragX, m_dragY), center, m_parentZoom, m_parentPanOffsetX, m_parentPanOffsetY)
+            .adjusted(-Constants::DragNubbleSize, -Constants::DragNubbleSize, Constants::DragNubbleSize, Constants::DragNubbleSize);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /// CanvasHistory
 ///
+CanvasHistory::CanvasHistory() :
+    m_memoryBudget(Constants::CanvasHistoryMemoryBudget)
+{
+}
+
 void CanvasHistory::recordHistory(CanvasHistoryItem canvasSnapShot)
 {
     m_history.push_back(canvasSnapShot);
+    addMemoryUsage(canvasSnapShot);
 
-    if((int)Constants::MaxCanvasHistory < m_history.size())
+    //Drop oldest history until back under budget (always keep latest)
+    while(m_memoryUsage > m_memoryBudget && m_history.size() > 1)
     {
+        removeMemoryUsage(m_history.first());
         m_history.erase(m_history.begin());
     }
 
@@ -2943,6 +3153,96 @@ bool CanvasHistory::undoHistory(CanvasHistoryItem& canvasSnapShot)
     return false;
 }
 
+bool CanvasHistory::currentHistory(CanvasHistoryItem& canvasSnapShot)
+{
+    if((int)m_historyIndex < m_history.size())
+    {
+        canvasSnapShot = m_history[size_t(m_historyIndex)];
+        return true;
+    }
+    return false;
+}
+
+void CanvasHistory::setMemoryBudget(const qint64& bytes)
+{
+    m_memoryBudget = bytes;
+
+    while(m_memoryUsage > m_memoryBudget && m_history.size() > 1)
+    {
+        removeMemoryUsage(m_history.first());
+        m_history.erase(m_history.begin());
+        if(m_historyIndex > 0)
+        {
+            m_historyIndex--;
+        }
+    }
+}
+
+qint64 CanvasHistory::memoryUsage()
+{
+    return m_memoryUsage;
+}
+
+void CanvasHistory::addMemoryUsage(const CanvasHistoryItem& canvasSnapShot)
+{
+    for(const TiledCanvasLayer& layer : canvasSnapShot.m_layers)
+    {
+        for(const TiledImage::Tile& tile : layer.m_image.tiles())
+        {
+            addDataReference(tile.m_compressedPixels.constData(), tile.m_compressedPixels.size());
+        }
+    }
+
+    const QImage& clipboardImage = canvasSnapShot.m_clipboard.m_clipboardImage;
+    if(!clipboardImage.isNull())
+    {
+        addDataReference(clipboardImage.constBits(), clipboardImage.sizeInBytes());
+    }
+}
+
+void CanvasHistory::removeMemoryUsage(const CanvasHistoryItem& canvasSnapShot)
+{
+    for(const TiledCanvasLayer& layer : canvasSnapShot.m_layers)
+    {
+        for(const TiledImage::Tile& tile : layer.m_image.tiles())
+        {
+            removeDataReference(tile.m_compressedPixels.constData(), tile.m_compressedPixels.size());
+        }
+    }
+
+    const QImage& clipboardImage = canvasSnapShot.m_clipboard.m_clipboardImage;
+    if(!clipboardImage.isNull())
+    {
+        removeDataReference(clipboardImage.constBits(), clipboardImage.sizeInBytes());
+    }
+}
+
+void CanvasHistory::addDataReference(const void* data, const qint64& size)
+{
+    int& references = m_dataReferences[data];
+    if(references == 0)
+    {
+        m_memoryUsage += size;
+    }
+    references++;
+}
+
+void CanvasHistory::removeDataReference(const void* data, const qint64& size)
+{
+    auto it = m_dataReferences.find(data);
+    if(it == m_dataReferences.end())
+    {
+        qDebug() << "CanvasHistory::removeDataReference - Data not found";
+        return;
+    }
+
+    if(--it.value() == 0)
+    {
+        m_memoryUsage -= size;
+        m_dataReferences.erase(it);
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /// ResizeNubble
 ///
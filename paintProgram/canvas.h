@@ -8,9 +8,19 @@
 #include <QTimer>
 #include <functional>
 #include <QMap>
+#include <QHash>
+#include <QBitArray>
+#include <QFutureWatcher>
+#include <QProgressDialog>
+#include <QPair>
 
 #include "tools.h"
 #include "canvaslayer.h"
+#include "selectionmask.h"
+#include "pixelkernels.h"
+#include "mippyramid.h"
+#include "layercompositor.h"
+#include "effectscheduler.h"
 
 class Canvas;
 class MainWindow;
@@ -23,7 +33,7 @@ class PaintableClipboard;
 class Clipboard
 {
 public:
-    QVector<QPoint> m_pixels;
+    SelectionMask m_pixels;
     QImage m_clipboardImage = QImage();
     int m_dragX = 0;
     int m_dragY = 0;
@@ -91,14 +101,14 @@ public:
 
     ///Pixel info
     bool containsPixels();
-    QVector<QPoint> getPixels();
+    const SelectionMask& getPixels();
 
     ///Pixel operations
     void operateOnSelectedPixels(std::function<void(int, int)> func);
 
     ///Adding pixels
     void addPixels(QImage& canvas, QRubberBand* newSelectionArea);
-    void addPixels(QImage& canvas, QVector<QVector<bool>>& selectedPixels);
+    void addPixels(QImage& canvas, const QBitArray& selectedPixels);
 
     ///Dragging
     void checkDragging(QImage& canvasImage, QPoint mouseLocation, QPointF globalMouseLocation);
@@ -121,17 +131,28 @@ private:
     void paintEvent(QPaintEvent* paintEvent) override;
     bool m_bOutlineColorToggle = false;
     QTimer* m_pOutlineDrawTimer;//Calls draw of outline of selected pixels every interval
-    QImage m_backgroundImage;
 
     ///Pixels
     void addImageToActiveClipboard(QImage& newPixelsImage);
     bool isHighlighted(const int& x, const int& y);
-    QVector<QPoint> getPixelsOffset();
+    SelectionMask getPixelsOffset();
 
-    ///Pixels borders
-    QList<QPair<QPoint, QPoint>> m_pixelBorders;
+    ///Highlight lookup (bitmap of m_pixels for isHighlighted)
+    QBitArray m_highlightLookup;
+    QRect m_highlightLookupRect = QRect();
+    void updateHighlightLookup();
+
+    ///Pixels borders (outline of m_pixels)
+    QPainterPath m_pixelBorders;
     void updatePixelBorders();
 
+    ///Selection overlay (highlight & transparent pixel background of m_pixels, in m_pixels bounding rect)
+    QImage m_selectionOverlayImage;
+    QRect m_selectionOverlayRect = QRect();
+    qint64 m_selectionOverlayClipboardKey = 0;//m_clipboardImage.cacheKey() the overlay was built from
+    bool m_bSelectionOverlayDirty = true;
+    void updateSelectionOverlay();
+
     enum OperationMode
     {
         NoOperation,
@@ -165,6 +186,7 @@ private:
     ///Nubble dimensions rect
     QRect m_dimensionsRect = QRect();
     void updateDimensionsRect();
+    QRect getDimensionsRectOnWidget();//Widget area that needs repainting when the clipboard moves
 
     ///Parent stuff
     Canvas* m_pParentCanvas;
@@ -182,25 +204,41 @@ private:
 class CanvasHistoryItem
 {
 public:
-    QList<CanvasLayer> m_layers;
+    QList<TiledCanvasLayer> m_layers;
     Clipboard m_clipboard;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /// CanvasHistory
 ///
-///Holds the history of actions on the canvas ~ may store only changes between
-///  saves later (instead of entire canvas and clipboard each time)
+///Holds the history of actions on the canvas. Layers are kept as compressed tiles, tiles that dont change between
+///  items are shared (so each item only costs the regions that changed). Oldest items are dropped to stay in a memory budget.
 class CanvasHistory
 {
 public:
+    CanvasHistory();
+
     void recordHistory(CanvasHistoryItem canvasSnapShot);
     bool redoHistory(CanvasHistoryItem& canvasSnapShot);
     bool undoHistory(CanvasHistoryItem& canvasSnapShot);
+    bool currentHistory(CanvasHistoryItem& canvasSnapShot);
+
+    ///Memory
+    void setMemoryBudget(const qint64& bytes);
+    qint64 memoryUsage();
 
 private:
     QList<CanvasHistoryItem> m_history;
     uint m_historyIndex = 0;
+
+    ///Memory
+    void addMemoryUsage(const CanvasHistoryItem& canvasSnapShot);
+    void removeMemoryUsage(const CanvasHistoryItem& canvasSnapShot);
+    void addDataReference(const void* data, const qint64& size);
+    void removeDataReference(const void* data, const qint64& size);
+    QHash<const void*, int> m_dataReferences;//Tile/image data -> number of times its held in m_history. So shared data is counted once
+    qint64 m_memoryUsage = 0;
+    qint64 m_memoryBudget;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -221,7 +259,9 @@ public:
     int height();
     QImage getImageCopy();
     QString getSavePath();
-    bool save(QString path);
+    void save(QString path);//Written on a worker thread, saveFinished is emitted when done
+    void autosave();//Saves to getAutosavePath() if there are changes since the last save/autosave
+    QString getAutosavePath();
 
     ///Layer stuff
     void onLayerAdded();
@@ -266,6 +306,7 @@ public:
                             const int blueXred, const int blueXgreen, const int blueXblue,
                             const int xTransparent);
     void onHueSaturation(const int& hue, const int& saturation);
+    void onLevels(const int inputBlack, const int inputWhite, const int gamma, const int outputBlack, const int outputWhite);//gamma is x100
     void onConfirmEffects();
     void onCancelEffects();
 
@@ -279,6 +320,8 @@ signals:
     void selectionAreaResize(const int x, const int y);
     void mousePositionChange(const int x, const int y);
     void canvasSizeChange(const int x, const int y);
+    void historyMemoryChange(const qint64 bytes);
+    void saveFinished(const QString path, const bool success);
 
 private:
     void init(uint width, uint height);
@@ -295,14 +338,48 @@ private:
     bool m_bMiddleMouseDown = false;
 
     ///Drawing
-    QList<CanvasLayer> m_canvasLayers;
+    QList<CanvasLayer> m_canvasLayers;//Enabled layers & the selected layer are always decoded
     uint m_selectedLayer;
-    QImage m_canvasBackgroundImage;    
+    void decodeLayer(const int& index);
+
+    ///Composites of the layers below & above the selected layer
+    LayerCompositor m_layerCompositor;
+
+    ///Mip levels of the selected layer, for drawing zoomed out
+    MipPyramid m_selectedLayerMips;
+
+    ///Effects
     QImage m_beforeEffectsImage;
     QImage getCanvasImageBeforeEffects();
     Clipboard m_beforeEffectsClipboard;
     Clipboard getClipboardBeforeEffects();
 
+    ///Adjustments (brightness, contrast, levels, multipliers, hue/saturation) - each dialog sets its own, all of them are
+    ///  applied together in one pass over the image before effects
+    PixelKernels::Adjustments m_adjustments;
+    void applyAdjustments();
+
+    ///Whole layer effects - previewed on a proxy of the visible canvas, only applied to the full layer on confirm
+    std::function<QImage(const QImage&)> m_layerEffect;//Effect being previewed (null if none)
+    int m_layerEffectMargin = 0;//Pixels around each pixel the effect reads, 0 for per pixel effects
+    QImage m_effectPreviewImage;//Latest finished preview frame
+    QRect m_effectPreviewRect;//Canvas area m_effectPreviewImage is drawn over
+    EffectScheduler* m_pEffectPreviewScheduler = nullptr;
+    quint64 m_effectPreviewRequestId = 0;
+    QRect m_effectPreviewRequestRect;//Canvas area the requested frame will cover
+    bool m_bEffectPreviewStale = false;//m_layerEffect changed since the last request
+    QRect m_effectPreviewVisibleRect;//What the last request was made for
+    int m_effectPreviewLevel = 0;
+    qint64 m_effectPreviewSourceKey = 0;
+    void previewLayerEffect(const std::function<QImage(const QImage&)>& layerEffect, const int& margin);
+    void requestEffectPreview();
+    void clearLayerEffect();
+    QFutureWatcher<QImage>* m_pLayerEffectWatcher = nullptr;
+    QProgressDialog* m_pLayerEffectProgress = nullptr;
+    bool m_bApplyingLayerEffect = false;
+    qint64 m_layerEffectTargetKey = 0;//QImage::cacheKey of the layer being applied to, when confirmed
+    void waitForLayerEffect();//Blocks until a confirmed effect has been applied
+
     ///Drawing text
     QString m_textToDraw = "";
     QPoint m_textDrawLocation;
@@ -329,18 +406,46 @@ private:
     ///Undo/redo
     CanvasHistory m_canvasHistory;
     CanvasHistoryItem getSnapshot();
+    void recordHistory();
+
+    //QImage::cacheKey of each decoded layer -> its tiles in the snapshot the canvas is at, & the part of it edited
+    //  since. cacheKey changes whenever an image is written to - edits reported to onSelectedLayerEdited carry the
+    //  tiles over to the new key, so only tiles under m_editedRect need tiling again. Layers not found are re-tiled whole.
+    struct TiledLayerCacheItem
+    {
+        TiledImage m_tiles;
+        QRect m_editedRect = QRect();
+    };
+    QHash<qint64, TiledLayerCacheItem> m_tiledLayerCache;
+    void cacheTiledLayers(const CanvasHistoryItem& snapshot);
 
     ///Geometry
     uint m_canvasWidth;
     uint m_canvasHeight;
     QPoint m_center;//Center of widget - not canvas
     void updateCenter();
+    void updateCanvasRect(const QRect& canvasRect);//update() only the area of the widget showing canvasRect
+    void onSelectedLayerEdited(const qint64& cacheKeyBeforeEdit, const QRect& editedRect);//Call after editing only editedRect of the selected layer
 
     Tool m_tool = TOOL_PAINT;
 
     MainWindow* m_pParent;
 
+    ///Saving
     QString m_savePath = "";
+    QFutureWatcher<bool>* m_pSaveWatcher = nullptr;
+    QString m_currentSavePath = "";//Path being written by m_pSaveWatcher
+    bool m_bCurrentSaveIsAutosave = false;
+    quint64 m_currentSaveChangeCount = 0;//m_changeCount when the current save snapshot the layers
+    QList<QPair<QString, bool>> m_pendingSaves;//Path & is autosave, of saves requested while another was being written
+    quint64 m_changeCount = 0;//Bumped by every edit
+    quint64 m_savedChangeCount = 0;//m_changeCount as of the last successfully written save or autosave
+    void startSave(const QString& path, const bool& bAutosave);
+
+private slots:
+    void onSaveFinished();
+    void onLayerEffectApplied();
+    void onEffectPreviewReady(const quint64 id, const QImage frame);
 };
 
 #endif // CANVAS_H
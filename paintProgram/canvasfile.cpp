@@ -0,0 +1,401 @@
+#include "canvasfile.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QTextStream>
+#include <QDebug>
+#include <QtEndian>
+#include <QtConcurrent>
+#include <cstring>
+#include <numeric>
+#include <limits>
+
+namespace CanvasFile
+{
+
+namespace
+{
+
+const char Magic[] = "PAINTPRG";
+const int MagicSize = 8;
+const quint32 CurrentVersion = 4;
+const quint32 OldestBinaryVersion = 2;
+
+//Version 1 (text) layer marker
+const QString TextLayerBegin = "BEGIN_LAYER";
+
+struct LayerTableEntry
+{
+    CanvasLayerInfo m_info;
+    qint32 m_width = 0;
+    qint32 m_height = 0;
+    quint32 m_codec = CodecDeflate;
+    quint64 m_chunkOffset = 0;
+    quint64 m_chunkSize = 0;
+    quint64 m_uncompressedSize = 0;
+};
+
+void setupStream(QDataStream& stream)
+{
+    stream.setVersion(QDataStream::Qt_5_12);
+    stream.setByteOrder(QDataStream::LittleEndian);
+}
+
+//ARGB32 rows packed together (no bytesPerLine padding), each pixel a little endian quint32
+QImage unpackPixels(const QByteArray& pixels, const int& width, const int& height)
+{
+    QImage image = QImage(QSize(width, height), QImage::Format_ARGB32);
+    const int rowBytes = width * int(sizeof(QRgb));
+    for(int y = 0; y < height; y++)
+    {
+        const uchar* row = reinterpret_cast<const uchar*>(pixels.constData()) + y * rowBytes;
+        std::memcpy(image.scanLine(y), row, size_t(rowBytes));
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for(int x = 0; x < width; x++)
+        {
+            line[x] = qFromLittleEndian<quint32>(row + x * sizeof(QRgb));
+        }
+#endif
+    }
+    return image;
+}
+
+QSize layerSize(const CanvasLayer& layer)
+{
+    return layer.m_undecodedImage.isNull() ? layer.m_image.size() : QSize(layer.m_undecodedImage.width(), layer.m_undecodedImage.height());
+}
+
+//CodecTiledPredictedDeflate chunk: quint32 tile size, quint32 tile count, then per tile quint64 hash, quint32 size, compressed pixels
+QByteArray encodeLayer(const CanvasLayer& layer, const TiledImage& layerTiles)
+{
+    //Layers that were never decoded are written from their tiles, as are layers the caller already has tiles of
+    const TiledImage tiledImage = (!layerTiles.isNull() ? layerTiles :
+                                   !layer.m_undecodedImage.isNull() ? layer.m_undecodedImage : TiledImage::fromImage(layer.m_image)).toFileTiles();
+    if(tiledImage.isNull())
+    {
+        return QByteArray();
+    }
+
+    QByteArray chunk;
+    QDataStream out(&chunk, QIODevice::WriteOnly);
+    setupStream(out);
+    out << quint32(TiledImage::TileSize) << quint32(tiledImage.tiles().size());
+    for(const TiledImage::Tile& tile : tiledImage.tiles())
+    {
+        out << tile.m_hash << quint32(tile.m_compressedPixels.size());
+        out.writeRawData(tile.m_compressedPixels.constData(), tile.m_compressedPixels.size());
+    }
+    return chunk;
+}
+
+//Only reads the (still compressed) tiles out of chunk, they are decompressed when the layer is first needed
+bool decodeTiledLayer(const QByteArray& chunk, const LayerTableEntry& entry, TiledImage& tiledImage)
+{
+    QDataStream in(chunk);
+    setupStream(in);
+
+    quint32 tileSize;
+    quint32 tileCount;
+    in >> tileSize >> tileCount;
+    if(in.status() != QDataStream::Ok || tileSize != quint32(TiledImage::TileSize) || quint64(tileCount) * 12 > quint64(chunk.size()))
+    {
+        qDebug() << "CanvasFile::decodeTiledLayer - Unsupported tiles in layer " << entry.m_info.m_name;
+        return false;
+    }
+
+    QVector<TiledImage::Tile> tiles(int(tileCount));
+    for(TiledImage::Tile& tile : tiles)
+    {
+        quint32 compressedSize;
+        in >> tile.m_hash >> compressedSize;
+        tile.m_predicted = entry.m_codec == CodecTiledPredictedDeflate;
+        if(in.status() != QDataStream::Ok || compressedSize > quint32(chunk.size()))
+        {
+            qDebug() << "CanvasFile::decodeTiledLayer - Corrupt layer " << entry.m_info.m_name;
+            return false;
+        }
+
+        //Copied out, as chunk may point into a file mapping
+        tile.m_compressedPixels = QByteArray(int(compressedSize), Qt::Uninitialized);
+        if(in.readRawData(tile.m_compressedPixels.data(), int(compressedSize)) != int(compressedSize))
+        {
+            qDebug() << "CanvasFile::decodeTiledLayer - Corrupt layer " << entry.m_info.m_name;
+            return false;
+        }
+    }
+
+    tiledImage = TiledImage::fromTiles(entry.m_width, entry.m_height, tiles);
+    return !tiledImage.isNull();
+}
+
+bool decodeLayer(const QByteArray& chunk, const LayerTableEntry& entry, CanvasLayer& layer)
+{
+    layer.m_info = entry.m_info;
+
+    if(entry.m_codec == CodecTiledDeflate || entry.m_codec == CodecTiledPredictedDeflate)
+    {
+        return decodeTiledLayer(chunk, entry, layer.m_undecodedImage);
+    }
+
+    if(entry.m_codec != CodecDeflate)
+    {
+        qDebug() << "CanvasFile::decodeLayer - Unknown codec " << entry.m_codec;
+        return false;
+    }
+
+    const QByteArray pixels = qUncompress(chunk);
+    if(quint64(pixels.size()) != entry.m_uncompressedSize || quint64(pixels.size()) != quint64(entry.m_width) * quint64(entry.m_height) * sizeof(QRgb))
+    {
+        qDebug() << "CanvasFile::decodeLayer - Corrupt layer " << entry.m_info.m_name;
+        return false;
+    }
+
+    layer.m_image = unpackPixels(pixels, entry.m_width, entry.m_height);
+    return true;
+}
+
+bool loadBinary(const QByteArray& data, QList<CanvasLayer>& layers)
+{
+    QDataStream in(data);
+    setupStream(in);
+
+    char magic[MagicSize];
+    in.readRawData(magic, MagicSize);
+
+    quint32 version;
+    quint32 layerCount;
+    qint32 canvasWidth;
+    qint32 canvasHeight;
+    in >> version >> layerCount >> canvasWidth >> canvasHeight;
+    if(version < OldestBinaryVersion || version > CurrentVersion)
+    {
+        qDebug() << "CanvasFile::loadBinary - Unsupported version " << version;
+        return false;
+    }
+
+    QList<LayerTableEntry> table;
+    for(quint32 i = 0; i < layerCount && in.status() == QDataStream::Ok; i++)
+    {
+        LayerTableEntry entry;
+        quint8 enabled;
+        in >> entry.m_info.m_name >> enabled >> entry.m_width >> entry.m_height >> entry.m_codec
+           >> entry.m_chunkOffset >> entry.m_chunkSize >> entry.m_uncompressedSize;
+        entry.m_info.m_enabled = enabled != 0;
+        table.push_back(entry);
+    }
+
+    if(in.status() != QDataStream::Ok)
+    {
+        qDebug() << "CanvasFile::loadBinary - Corrupt header";
+        return false;
+    }
+
+    const quint64 chunksStart = quint64(in.device()->pos());
+    const quint64 chunksSize = quint64(data.size()) - chunksStart;
+
+    QList<QByteArray> chunks;
+    for(const LayerTableEntry& entry : table)
+    {
+        if(entry.m_chunkOffset > chunksSize || entry.m_chunkSize > chunksSize - entry.m_chunkOffset || entry.m_width <= 0 || entry.m_height <= 0)
+        {
+            qDebug() << "CanvasFile::loadBinary - Corrupt layer table";
+            return false;
+        }
+        chunks.push_back(QByteArray::fromRawData(data.constData() + chunksStart + entry.m_chunkOffset, int(entry.m_chunkSize)));
+    }
+
+    //Decode layers concurrently, each into its own slot so order is kept
+    QVector<CanvasLayer> decodedLayers(table.size());
+    QVector<char> decoded(table.size(), false);
+    CanvasLayer* layerSlots = decodedLayers.data();//Detach before going across threads
+    char* decodedSlots = decoded.data();
+    QVector<int> layerIndexes(table.size());
+    std::iota(layerIndexes.begin(), layerIndexes.end(), 0);
+    QtConcurrent::blockingMap(layerIndexes, [&](const int& i)-> void
+    {
+        decodedSlots[i] = decodeLayer(chunks.at(i), table.at(i), layerSlots[i]);
+    });
+
+    bool success = true;
+    QList<CanvasLayer> loadedLayers;
+    for(int i = 0; i < table.size(); i++)
+    {
+        if(!decoded[i])
+        {
+            qDebug() << "CanvasFile::loadBinary - Failed to decode layer " << i << " " << table[i].m_info.m_name;
+            success = false;
+            continue;
+        }
+
+        loadedLayers.push_back(decodedLayers[i]);
+    }
+
+    if(!success)
+    {
+        return false;
+    }
+
+    layers = loadedLayers;
+    return true;
+}
+
+bool loadText(QFile& file, QList<CanvasLayer>& layers)
+{
+    QTextStream in(&file);
+
+    //Read every layer first, then decode the PNGs concurrently
+    QList<CanvasLayerInfo> infos;
+    QList<QByteArray> imageDatas;
+    while(!in.atEnd())
+    {
+        QString line = in.readLine();
+        if(line == TextLayerBegin)
+        {
+            //Read layer info
+            CanvasLayerInfo info;
+            info.m_name = in.readLine();
+            info.m_enabled = in.readLine() == "1" ? true : false;
+            infos.push_back(info);
+
+            //Read layer image data
+            QByteArray ba;
+            QTextStream(&ba) << in.readLine();
+            imageDatas.push_back(QByteArray::fromHex(ba));
+        }
+    }
+
+    QVector<QImage> images(infos.size());
+    QImage* imageSlots = images.data();//Detach before going across threads
+    QVector<int> layerIndexes(infos.size());
+    std::iota(layerIndexes.begin(), layerIndexes.end(), 0);
+    QtConcurrent::blockingMap(layerIndexes, [&](const int& i)-> void
+    {
+        imageSlots[i].loadFromData(imageDatas.at(i));
+    });
+
+    QList<CanvasLayer> loadedLayers;
+    for(int i = 0; i < infos.size(); i++)
+    {
+        if(images[i].isNull())
+        {
+            qDebug() << "CanvasFile::loadText - Skipping unreadable layer " << i << " " << infos[i].m_name;
+            continue;
+        }
+
+        CanvasLayer cl;
+        cl.m_info = infos[i];
+        cl.m_image = images[i];
+        loadedLayers.push_back(cl);
+    }
+
+    layers = loadedLayers;
+    return true;
+}
+
+bool load(const QString& path, QList<CanvasLayer>& layers)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        qDebug() << "CanvasFile::load - Failed to open " << path;
+        return false;
+    }
+
+    if(file.peek(MagicSize) == QByteArray(Magic, MagicSize))
+    {
+        //Mapped rather than read, so only the pages of the file that are parsed get loaded
+        const qint64 fileSize = file.size();
+        uchar* mappedFile = fileSize <= std::numeric_limits<int>::max() ? file.map(0, fileSize) : nullptr;
+        if(!mappedFile)
+        {
+            return loadBinary(file.readAll(), layers);
+        }
+
+        const bool success = loadBinary(QByteArray::fromRawData(reinterpret_cast<const char*>(mappedFile), int(fileSize)), layers);
+        file.unmap(mappedFile);
+        return success;
+    }
+
+    //Older text format
+    file.close();
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        qDebug() << "CanvasFile::load - Failed to open " << path;
+        return false;
+    }
+    return loadText(file, layers);
+}
+
+bool save(const QString& path, const QList<CanvasLayer>& layers, const QList<TiledImage>& layerTiles)
+{
+    //Compress layers (concurrently, each into its own slot so order is kept) first so the table can hold chunk offsets & sizes
+    QVector<QByteArray> chunks(layers.size());
+    QByteArray* chunkSlots = chunks.data();//Detach before going across threads
+    QVector<int> layerIndexes(layers.size());
+    std::iota(layerIndexes.begin(), layerIndexes.end(), 0);
+    QtConcurrent::blockingMap(layerIndexes, [&](const int& i)-> void
+    {
+        chunkSlots[i] = encodeLayer(layers[i], i < layerTiles.size() ? layerTiles[i] : TiledImage());
+    });
+
+    for(int i = 0; i < chunks.size(); i++)
+    {
+        if(chunks[i].isEmpty())
+        {
+            qDebug() << "CanvasFile::save - Failed to encode layer " << i << " " << layers[i].m_info.m_name;
+            return false;
+        }
+    }
+
+    QByteArray header;
+    QDataStream headerStream(&header, QIODevice::WriteOnly);
+    setupStream(headerStream);
+    headerStream.writeRawData(Magic, MagicSize);
+    const QSize canvasSize = layers.isEmpty() ? QSize(0, 0) : layerSize(layers[0]);
+    headerStream << CurrentVersion << quint32(layers.size()) << qint32(canvasSize.width()) << qint32(canvasSize.height());
+
+    QByteArray table;
+    QDataStream tableStream(&table, QIODevice::WriteOnly);
+    setupStream(tableStream);
+    quint64 chunkOffset = 0;
+    for(int i = 0; i < layers.size(); i++)
+    {
+        const CanvasLayer& layer = layers[i];
+        const QSize size = layerSize(layer);
+        tableStream << layer.m_info.m_name << quint8(layer.m_info.m_enabled ? 1 : 0)
+                    << qint32(size.width()) << qint32(size.height()) << quint32(CodecTiledPredictedDeflate)
+                    << chunkOffset << quint64(chunks[i].size())
+                    << quint64(quint64(size.width()) * quint64(size.height()) * sizeof(QRgb));
+        chunkOffset += quint64(chunks[i].size());
+    }
+
+    //Written to a temporary file that replaces path on commit, so a failed or interrupted save never
+    //  leaves a half written file behind
+    QSaveFile file(path);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        qDebug() << "CanvasFile::save - Failed to open " << path;
+        return false;
+    }
+
+    bool success = file.write(header) == header.size() && file.write(table) == table.size();
+    for(const QByteArray& chunk : chunks)
+    {
+        success = success && file.write(chunk) == chunk.size();
+    }
+
+    if(!success)
+    {
+        file.cancelWriting();
+    }
+    if(!file.commit() || !success)
+    {
+        qDebug() << "CanvasFile::save - Failed to write " << path;
+        return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,48 @@
+#ifndef CANVASFILE_H
+#define CANVASFILE_H
+
+#include <QList>
+#include <QString>
+
+#include "canvaslayer.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// CanvasFile
+///
+///Reading/writing .paintProgram files.
+///
+///Versions 4 (written), 3 & 2 are binary, little endian:
+///  Header      - magic "PAINTPRG", quint32 version, quint32 layer count, qint32 canvas width, qint32 canvas height
+///  Layer table - per layer: QString name, quint8 enabled, qint32 width, qint32 height, quint32 codec,
+///                           quint64 chunk offset (from end of table), quint64 chunk size, quint64 uncompressed size
+///  Chunks      - per layer, by codec:
+///                  CodecDeflate (version 2)               - ARGB32 pixels (rows packed, no padding) compressed with qCompress
+///                  CodecTiledDeflate (version 3)          - the tiles of a TiledImage, each compressed with qCompress
+///                  CodecTiledPredictedDeflate (version 4) - as CodecTiledDeflate, but each byte of a tile row is stored as
+///                                                           its difference from the pixel to the left before compressing
+///
+///Version 1 (read only) is text: BEGIN_LAYER, name, enabled, hex encoded PNG, END_LAYER per layer.
+namespace CanvasFile
+{
+
+enum LayerCodec : quint32
+{
+    CodecDeflate = 0,              //qCompress of the whole layer
+    CodecTiledDeflate = 1,         //qCompress per TiledImage tile
+    CodecTiledPredictedDeflate = 2 //qCompress per TiledImage tile, of the differences along each row
+};
+
+//Layers are decoded concurrently. Tiled layers are only read as far as their compressed tiles, which are
+//  left in CanvasLayer::m_undecodedImage. Returns false (and leaves layers untouched) if path couldnt be read
+//  or any layer failed to decode - each failed layer is logged.
+bool load(const QString& path, QList<CanvasLayer>& layers);
+
+//Layers are encoded concurrently, then written in layer order. Replaces path atomically - on failure the
+//  existing file is left as it was. Safe to call from a worker thread.
+//layerTiles, where not null, are tiles of the matching layer's image the caller already has (eg its history tiles),
+//  written instead of tiling the image again.
+bool save(const QString& path, const QList<CanvasLayer>& layers, const QList<TiledImage>& layerTiles = QList<TiledImage>());
+
+}
+
+#endif // CANVASFILE_H
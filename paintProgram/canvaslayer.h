@@ -3,6 +3,8 @@
 
 #include <QImage>
 
+#include "tiledimage.h"
+
 struct CanvasLayerInfo
 {
     QString m_name = "New Layer";
@@ -13,6 +15,16 @@ struct CanvasLayer
 {
     CanvasLayerInfo m_info;
     QImage m_image;
+
+    //Layers loaded from file arent decoded until needed - until then their compressed tiles are kept here & m_image is null
+    TiledImage m_undecodedImage;
+};
+
+//CanvasLayer as kept in canvas history. Tiles unchanged between snapshots are shared.
+struct TiledCanvasLayer
+{
+    CanvasLayerInfo m_info;
+    TiledImage m_image;
 };
 
 #endif // CANVASLAYER_H
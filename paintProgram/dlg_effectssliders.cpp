@@ -37,25 +37,33 @@ void DLG_EffectsSliders::show()
 
 void DLG_EffectsSliders::on_slider_brightness_sliderMoved(int value)
 {
+    ui->spinBox_brightness->blockSignals(true);
     ui->spinBox_brightness->setValue(value);
+    ui->spinBox_brightness->blockSignals(false);
     emit onBrightness(value);
 }
 
 void DLG_EffectsSliders::on_spinBox_brightness_valueChanged(int value)
 {
+    ui->slider_brightness->blockSignals(true);
     ui->slider_brightness->setValue(value);
+    ui->slider_brightness->blockSignals(false);
     emit onBrightness(value);
 }
 
 void DLG_EffectsSliders::on_slider_contrast_valueChanged(int value)
 {
+    ui->spinBox_contrast->blockSignals(true);
     ui->spinBox_contrast->setValue(value);
+    ui->spinBox_contrast->blockSignals(false);
     emit onContrast(value);
 }
 
 void DLG_EffectsSliders::on_spinBox_contrast_valueChanged(int value)
 {
+    ui->slider_contrast->blockSignals(true);
     ui->slider_contrast->setValue(value);
+    ui->slider_contrast->blockSignals(false);
     emit onContrast(value);
 }
 
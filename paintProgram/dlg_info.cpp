@@ -28,3 +28,8 @@ void DLG_Info::onCanvasSizeChange(const int x, const int y)
 {
     ui->text_cavasSize->setText(QString::number(x) + "x" + QString::number(y));
 }
+
+void DLG_Info::onHistoryMemoryChange(const qint64 bytes)
+{
+    ui->text_historyMemory->setText(QString::number(double(bytes) / (1024 * 1024), 'f', 1) + "MB");
+}
@@ -7,7 +7,7 @@ namespace Ui {
 class DLG_Info;
 }
 
-//Selection area size & Mouse position & canvas size
+//Selection area size & Mouse position & canvas size & undo history memory
 
 class DLG_Info : public QDialog
 {
@@ -21,6 +21,7 @@ public slots:
     void onSelectionAreaResize(const int x, const int y);
     void onMousePositionChange(const int x, const int y);
     void onCanvasSizeChange(const int x, const int y);
+    void onHistoryMemoryChange(const qint64 bytes);
 
 private:
     Ui::DLG_Info *ui;
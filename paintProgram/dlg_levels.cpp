@@ -0,0 +1,98 @@
+#include "dlg_levels.h"
+#include "ui_dlg_levels.h"
+
+namespace Constants
+{
+const int DefaultBlack = 0;
+const int DefaultWhite = 255;
+const int DefaultGamma = 100;
+}
+
+DLG_Levels::DLG_Levels(QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::DLG_Levels)
+{
+    ui->setupUi(this);
+    setWindowFlags(Qt::Dialog | Qt::WindowTitleHint | Qt::CustomizeWindowHint);
+}
+
+DLG_Levels::~DLG_Levels()
+{
+    delete ui;
+}
+
+void DLG_Levels::show()
+{
+    reset();
+    QDialog::show();
+}
+
+void DLG_Levels::closeEvent(QCloseEvent *e)
+{
+    emit cancelEffects();
+    QDialog::closeEvent(e);
+}
+
+void DLG_Levels::on_btn_ok_clicked()
+{
+    emit confirmEffects();
+    hide();
+}
+
+void DLG_Levels::on_btn_cancel_clicked()
+{
+    emit cancelEffects();
+    hide();
+}
+
+void DLG_Levels::on_spinBox_inputBlack_valueChanged(int)
+{
+    emitLevels();
+}
+
+void DLG_Levels::on_spinBox_inputWhite_valueChanged(int)
+{
+    emitLevels();
+}
+
+void DLG_Levels::on_spinBox_gamma_valueChanged(int)
+{
+    emitLevels();
+}
+
+void DLG_Levels::on_spinBox_outputBlack_valueChanged(int)
+{
+    emitLevels();
+}
+
+void DLG_Levels::on_spinBox_outputWhite_valueChanged(int)
+{
+    emitLevels();
+}
+
+void DLG_Levels::emitLevels()
+{
+    emit onLevels(ui->spinBox_inputBlack->value(), ui->spinBox_inputWhite->value(), ui->spinBox_gamma->value(),
+                  ui->spinBox_outputBlack->value(), ui->spinBox_outputWhite->value());
+}
+
+void DLG_Levels::reset()
+{
+    //Blocked so resetting doesnt emit a levels change per spin box
+    const QList<QSpinBox*> spinBoxes = {ui->spinBox_inputBlack, ui->spinBox_inputWhite, ui->spinBox_gamma, ui->spinBox_outputBlack, ui->spinBox_outputWhite};
+    for(QSpinBox* spinBox : spinBoxes)
+    {
+        spinBox->blockSignals(true);
+    }
+
+    ui->spinBox_inputBlack->setValue(Constants::DefaultBlack);
+    ui->spinBox_inputWhite->setValue(Constants::DefaultWhite);
+    ui->spinBox_gamma->setValue(Constants::DefaultGamma);
+    ui->spinBox_outputBlack->setValue(Constants::DefaultBlack);
+    ui->spinBox_outputWhite->setValue(Constants::DefaultWhite);
+
+    for(QSpinBox* spinBox : spinBoxes)
+    {
+        spinBox->blockSignals(false);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef DLG_LEVELS_H
+#define DLG_LEVELS_H
+
+#include <QDialog>
+
+namespace Ui {
+class DLG_Levels;
+}
+
+class DLG_Levels : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit DLG_Levels(QWidget *parent = nullptr);
+    ~DLG_Levels();
+
+    void show();
+
+signals:
+    //gamma is x100
+    void onLevels(const int inputBlack, const int inputWhite, const int gamma, const int outputBlack, const int outputWhite);
+
+    void confirmEffects();
+    void cancelEffects();
+
+private slots:
+    void on_btn_ok_clicked();
+    void on_btn_cancel_clicked();
+
+    void on_spinBox_inputBlack_valueChanged(int value);
+    void on_spinBox_inputWhite_valueChanged(int value);
+    void on_spinBox_gamma_valueChanged(int value);
+    void on_spinBox_outputBlack_valueChanged(int value);
+    void on_spinBox_outputWhite_valueChanged(int value);
+
+private:
+    Ui::DLG_Levels *ui;
+
+    void closeEvent(QCloseEvent *e) override;
+
+    void emitLevels();
+
+    void reset();
+};
+
+#endif // DLG_LEVELS_H
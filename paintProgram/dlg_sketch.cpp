@@ -23,25 +23,33 @@ void DLG_Sketch::show()
 
 void DLG_Sketch::on_slider_outline_valueChanged(int value)
 {
+    ui->spinBox_outline->blockSignals(true);
     ui->spinBox_outline->setValue(value);
+    ui->spinBox_outline->blockSignals(false);
     emit onOutlineEffect(value);
 }
 
 void DLG_Sketch::on_spinBox_outline_valueChanged(int value)
 {
+    ui->slider_outline->blockSignals(true);
     ui->slider_outline->setValue(value);
+    ui->slider_outline->blockSignals(false);
     emit onOutlineEffect(value);
 }
 
 void DLG_Sketch::on_slider_sketch_valueChanged(int value)
 {
+    ui->spinBox_sketch->blockSignals(true);
     ui->spinBox_sketch->setValue(value);
+    ui->spinBox_sketch->blockSignals(false);
     emit onSketchEffect(value);
 }
 
 void DLG_Sketch::on_spinBox_sketch_valueChanged(int value)
 {
+    ui->slider_sketch->blockSignals(true);
     ui->slider_sketch->setValue(value);
+    ui->slider_sketch->blockSignals(false);
     emit onSketchEffect(value);
 }
 
@@ -0,0 +1,78 @@
+#include "effectscheduler.h"
+
+#include "pixelkernels.h"
+
+EffectScheduler::EffectScheduler(QObject* parent) :
+    QObject(parent),
+    m_pWatcher(new QFutureWatcher<QImage>(this)),
+    m_bRunningPassCancelled(false)
+{
+    connect(m_pWatcher, SIGNAL(finished()), this, SLOT(onPassFinished()));
+}
+
+EffectScheduler::~EffectScheduler()
+{
+    //Running pass reads m_bRunningPassCancelled, so it cant outlive this
+    cancel();
+    m_pWatcher->waitForFinished();
+}
+
+quint64 EffectScheduler::schedule(const std::function<QImage()>& pass)
+{
+    m_pendingPass = pass;
+    m_latestId++;
+
+    if(m_bPassRunning)
+    {
+        //Started when the running pass finishes, which it does sooner once cancelled
+        m_bRunningPassCancelled = true;
+    }
+    else
+    {
+        startPendingPass();
+    }
+
+    return m_latestId;
+}
+
+void EffectScheduler::cancel()
+{
+    m_pendingPass = nullptr;
+    m_bRunningPassCancelled = true;
+
+    //Running pass is no longer the latest, so its result is dropped
+    m_latestId++;
+}
+
+void EffectScheduler::startPendingPass()
+{
+    const std::function<QImage()> pass = m_pendingPass;
+    m_pendingPass = nullptr;
+
+    m_runningId = m_latestId;
+    m_bRunningPassCancelled = false;
+    m_bPassRunning = true;
+
+    const std::atomic<bool>* pCancelled = &m_bRunningPassCancelled;
+    m_pWatcher->setFuture(QtConcurrent::run([pass, pCancelled]()-> QImage
+    {
+        PixelKernels::CancelScope cancelScope(*pCancelled);
+        return pass();
+    }));
+}
+
+void EffectScheduler::onPassFinished()
+{
+    m_bPassRunning = false;
+
+    if(m_pendingPass)
+    {
+        startPendingPass();
+        return;
+    }
+
+    if(m_runningId == m_latestId)
+    {
+        emit frameReady(m_runningId, m_pWatcher->result());
+    }
+}
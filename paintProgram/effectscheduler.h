@@ -0,0 +1,49 @@
+#ifndef EFFECTSCHEDULER_H
+#define EFFECTSCHEDULER_H
+
+#include <QObject>
+#include <QImage>
+#include <QFutureWatcher>
+#include <functional>
+#include <atomic>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// EffectScheduler
+///
+///Runs effect passes (ie live previews while an effect dialogs sliders move) one at a time on a worker thread.
+///  Only the latest request matters - a request made while a pass is running cancels that pass (through
+///  PixelKernels::CancelScope) and replaces any request already waiting, so a burst of slider ticks costs the pass
+///  in flight plus the last one. frameReady is only emitted for the latest request.
+class EffectScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit EffectScheduler(QObject* parent = nullptr);
+    ~EffectScheduler();
+
+    //Returns the id frameReady will give pass's result
+    quint64 schedule(const std::function<QImage()>& pass);
+
+    //Drops any waiting request & cancels the running pass. Nothing is emitted until the next schedule.
+    void cancel();
+
+signals:
+    void frameReady(const quint64 id, const QImage frame);
+
+private slots:
+    void onPassFinished();
+
+private:
+    void startPendingPass();
+
+    QFutureWatcher<QImage>* m_pWatcher;
+    std::atomic<bool> m_bRunningPassCancelled;//Read by the running pass
+    bool m_bPassRunning = false;
+    quint64 m_runningId = 0;
+
+    std::function<QImage()> m_pendingPass;//Null if none
+    quint64 m_latestId = 0;
+};
+
+#endif // EFFECTSCHEDULER_H
@@ -0,0 +1,77 @@
+#include "floodfill.h"
+
+namespace FloodFill
+{
+
+namespace
+{
+
+bool isInRange(const int value, const int target, const int sensitivity)
+{
+    return value <= target + sensitivity && value >= target - sensitivity;
+}
+
+}
+
+QBitArray spreadSelectSimilarColor(const QImage& image, QPoint startPixel, int sensitivty)
+{
+    if(startPixel.x() >= image.width() || startPixel.x() < 0 || startPixel.y() >= image.height() || startPixel.y() < 0)
+        return QBitArray(image.width() * image.height());
+
+    const QRgb colorToSpreadOver = image.pixel(startPixel);
+
+    return scanlineFloodFill(image, startPixel, [&](const QRgb pixelColor)-> bool
+    {
+        return isInRange(qRed(pixelColor), qRed(colorToSpreadOver), sensitivty) &&
+               isInRange(qGreen(pixelColor), qGreen(colorToSpreadOver), sensitivty) &&
+               isInRange(qBlue(pixelColor), qBlue(colorToSpreadOver), sensitivty) &&
+               isInRange(qAlpha(pixelColor), qAlpha(colorToSpreadOver), sensitivty);
+    }).filledPixels;
+}
+
+QRect floodFillOnSimilar(QImage &image, QColor newColor, int startX, int startY, int sensitivity)
+{
+    QRect filledRect;
+    if(startX < image.width() && startX > -1 && startY < image.height() && startY > -1)
+    {
+        //Written to below, so convert up front (the fill then reads it without another conversion)
+        PixelKernels::ensureArgb32(image);
+
+        const QRgb originalPixelColor = image.pixel(startX, startY);
+        const QRgb newRgb = newColor.rgba();
+
+        const FloodFillResult fill = scanlineFloodFill(image, QPoint(startX, startY), [&](const QRgb pixelColor)-> bool
+        {
+            //Check pixel color in sensitivity range
+            return isInRange(qRed(pixelColor), qRed(originalPixelColor), sensitivity) &&
+                   isInRange(qGreen(pixelColor), qGreen(originalPixelColor), sensitivity) &&
+                   isInRange(qBlue(pixelColor), qBlue(originalPixelColor), sensitivity) &&
+
+                   //Check not excat same color
+                   pixelColor != newRgb;
+        });
+
+        //Switch color, only looking at the part of the image that was filled
+        filledRect = fill.filledRect;
+        if(!filledRect.isEmpty())
+        {
+            const int width = image.width();
+            uchar* bits = image.bits();
+            const qsizetype bytesPerLine = image.bytesPerLine();
+            for(int y = filledRect.top(); y <= filledRect.bottom(); y++)
+            {
+                QRgb* line = reinterpret_cast<QRgb*>(bits + y * bytesPerLine);
+                for(int x = filledRect.left(); x <= filledRect.right(); x++)
+                {
+                    if(fill.filledPixels.testBit(y * width + x))
+                    {
+                        line[x] = newRgb;
+                    }
+                }
+            }
+        }
+    }
+    return filledRect;
+}
+
+}
@@ -0,0 +1,117 @@
+#ifndef FLOODFILL_H
+#define FLOODFILL_H
+
+#include <QImage>
+#include <QBitArray>
+#include <QColor>
+#include <QPoint>
+#include <QRect>
+#include <stack>
+
+#include "pixelkernels.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// FloodFill
+///
+///Filling & selecting regions of similar colour, as the bucket and spread select tools do.
+namespace FloodFill
+{
+
+struct FloodFillResult
+{
+    QBitArray filledPixels;//Row major width * height
+    QRect filledRect;//Bounding rect of filledPixels, empty if none
+};
+
+//Scanline (span) flood fill from startPixel. Finds every pixel connected to startPixel (4 way) for which
+//  shouldFill(QRgb) is true. Only one seed per span is stacked, not one per pixel, and the mask doubles as the
+//  visited check.
+template<typename FillCheck>
+FloodFillResult scanlineFloodFill(const QImage& sourceImage, const QPoint& startPixel, FillCheck&& shouldFill)
+{
+    const QImage image = PixelKernels::toArgb32(sourceImage);
+
+    const int width = image.width();
+    const int height = image.height();
+    FloodFillResult result;
+    result.filledPixels = QBitArray(width * height);
+    QBitArray& filledPixels = result.filledPixels;
+
+    if(startPixel.x() < 0 || startPixel.x() >= width || startPixel.y() < 0 || startPixel.y() >= height)
+    {
+        return result;
+    }
+
+    const uchar* bits = image.constBits();
+    const qsizetype bytesPerLine = image.bytesPerLine();
+
+    auto canFill = [&](const QRgb* line, const int x, const int y)-> bool
+    {
+        return !filledPixels.testBit(y * width + x) && shouldFill(line[x]);
+    };
+
+    std::stack<QPoint> seeds;
+    seeds.push(startPixel);
+
+    while(!seeds.empty())
+    {
+        const QPoint seed = seeds.top();
+        seeds.pop();
+        const int y = seed.y();
+        const QRgb* line = reinterpret_cast<const QRgb*>(bits + y * bytesPerLine);
+
+        if(!canFill(line, seed.x(), y))
+        {
+            continue;
+        }
+
+        //Grow span left and right of seed
+        int left = seed.x();
+        while(left > 0 && canFill(line, left - 1, y))
+        {
+            left--;
+        }
+        int right = seed.x();
+        while(right + 1 < width && canFill(line, right + 1, y))
+        {
+            right++;
+        }
+
+        filledPixels.fill(true, y * width + left, y * width + right + 1);
+        result.filledRect |= QRect(left, y, right - left + 1, 1);
+
+        //Stack one seed for each run of fillable pixels above and below the span
+        for(const int neighbourY : {y - 1, y + 1})
+        {
+            if(neighbourY < 0 || neighbourY >= height)
+            {
+                continue;
+            }
+
+            const QRgb* neighbourLine = reinterpret_cast<const QRgb*>(bits + neighbourY * bytesPerLine);
+            bool inRun = false;
+            for(int x = left; x <= right; x++)
+            {
+                const bool fillable = canFill(neighbourLine, x, neighbourY);
+                if(fillable && !inRun)
+                {
+                    seeds.push(QPoint(x, neighbourY));
+                }
+                inRun = fillable;
+            }
+        }
+    }
+
+    return result;
+}
+
+//Pixels connected to startPixel with every channel (alpha included) within sensitivty of it. Row major width * height.
+QBitArray spreadSelectSimilarColor(const QImage& image, QPoint startPixel, int sensitivty);
+
+//Sets the pixels connected to (startX, startY) with their colour within sensitivity of it to newColor.
+//  Returns the bounding rect of the pixels filled (empty if none were)
+QRect floodFillOnSimilar(QImage &image, QColor newColor, int startX, int startY, int sensitivity);
+
+}
+
+#endif // FLOODFILL_H
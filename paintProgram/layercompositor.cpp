@@ -0,0 +1,91 @@
+#include "layercompositor.h"
+
+const QColor LayerCompositor::TransparentGrey = QColor(190,190,190,255);
+const QColor LayerCompositor::TransparentWhite = QColor(255,255,255,255);
+
+LayerCompositor::LayerCompositor()
+{
+}
+
+//Tiled by QPainter, so its never generated per pixel
+const QBrush& LayerCompositor::transparentPixelsBrush()
+{
+    static const QBrush brush = []()-> QBrush
+    {
+        QImage pattern = QImage(QSize(2, 2), QImage::Format_ARGB32);
+        pattern.setPixelColor(0, 0, TransparentWhite);
+        pattern.setPixelColor(1, 1, TransparentWhite);
+        pattern.setPixelColor(1, 0, TransparentGrey);
+        pattern.setPixelColor(0, 1, TransparentGrey);
+        return QBrush(pattern);
+    }();
+    return brush;
+}
+
+void LayerCompositor::update(const QList<CanvasLayer>& layers, const int& selectedLayer, const QSize& canvasSize)
+{
+    //QImage::cacheKey changes whenever an image is edited, so the composites only need rebuilding when the
+    //  layers in them are edited, enabled/disabled, reordered or a different layer is selected
+    QVector<qint64> compositesKey;
+    compositesKey.reserve(layers.size() + 3);
+    compositesKey.push_back(selectedLayer);
+    compositesKey.push_back(canvasSize.width());
+    compositesKey.push_back(canvasSize.height());
+    for(int i = 0; i < layers.size(); i++)
+    {
+        const bool inComposite = i != selectedLayer && layers[i].m_info.m_enabled;
+        compositesKey.push_back(inComposite ? layers[i].m_image.cacheKey() : 0);
+    }
+
+    if(compositesKey == m_compositesKey)
+    {
+        return;
+    }
+    m_compositesKey = compositesKey;
+
+    m_belowSelectedLayerImage = QImage(canvasSize, QImage::Format_ARGB32_Premultiplied);
+    m_aboveSelectedLayerImage = QImage(canvasSize, QImage::Format_ARGB32_Premultiplied);
+    m_aboveSelectedLayerImage.fill(Qt::transparent);
+
+    //Switch out transparent pixels for grey-white pattern
+    QPainter belowPainter(&m_belowSelectedLayerImage);
+    belowPainter.fillRect(m_belowSelectedLayerImage.rect(), transparentPixelsBrush());
+
+    QPainter abovePainter(&m_aboveSelectedLayerImage);
+    for(int i = 0; i < layers.size(); i++)
+    {
+        if(i != selectedLayer && layers[i].m_info.m_enabled)
+        {
+            QPainter& painter = i < selectedLayer ? belowPainter : abovePainter;
+            painter.drawImage(0, 0, layers[i].m_image);
+        }
+    }
+}
+
+void LayerCompositor::drawBelowSelectedLayer(QPainter& painter, const QRect& exposedRect, const float& zoomFactor, const QPoint& offset)
+{
+    drawCanvasImage(painter, m_belowSelectedLayerImage, m_belowSelectedLayerMips, exposedRect, zoomFactor, offset);
+}
+
+void LayerCompositor::drawAboveSelectedLayer(QPainter& painter, const QRect& exposedRect, const float& zoomFactor, const QPoint& offset)
+{
+    drawCanvasImage(painter, m_aboveSelectedLayerImage, m_aboveSelectedLayerMips, exposedRect, zoomFactor, offset);
+}
+
+void LayerCompositor::drawCanvasImage(QPainter& painter, const QImage& image, MipPyramid& mipPyramid, const QRect& exposedRect,
+                                      const float& zoomFactor, const QPoint& offset)
+{
+    const int level = mipPyramid.sync(image, MipPyramid::levelForZoom(zoomFactor));
+    if(level == 0)
+    {
+        painter.drawImage(exposedRect.translated(offset), image, exposedRect);
+        return;
+    }
+
+    const int levelScale = 1 << level;
+    const QRect levelRect = QRect(QPoint(exposedRect.left() / levelScale, exposedRect.top() / levelScale),
+                                  QPoint(exposedRect.right() / levelScale, exposedRect.bottom() / levelScale));
+    const QRectF targetRect = QRectF(levelRect.x() * levelScale + offset.x(), levelRect.y() * levelScale + offset.y(),
+                                     levelRect.width() * levelScale, levelRect.height() * levelScale);
+    painter.drawImage(targetRect, mipPyramid.level(level), QRectF(levelRect));
+}
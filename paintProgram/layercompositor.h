@@ -0,0 +1,51 @@
+#ifndef LAYERCOMPOSITOR_H
+#define LAYERCOMPOSITOR_H
+
+#include <QImage>
+#include <QList>
+#include <QVector>
+#include <QPainter>
+#include <QBrush>
+#include <QColor>
+
+#include "canvaslayer.h"
+#include "mippyramid.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// LayerCompositor
+///
+///Draws the canvas layers. The enabled layers below the selected layer (on the transparent pixels background) & above
+///  it are kept composited, so a frame is three blits however many layers there are - only the selected layer is
+///  drawn on its own, as its the one being edited.
+class LayerCompositor
+{
+public:
+    LayerCompositor();
+
+    //Grey-white checker drawn behind transparent pixels
+    static const QColor TransparentGrey;
+    static const QColor TransparentWhite;
+    static const QBrush& transparentPixelsBrush();
+
+    //Rebuilds the composites if any layer in them was edited, enabled/disabled or reordered, a different layer was
+    //  selected or the canvas resized since the last call
+    void update(const QList<CanvasLayer>& layers, const int& selectedLayer, const QSize& canvasSize);
+
+    //Draw exposedRect (in canvas pixels) of the composites, with the canvas at offset on painter
+    void drawBelowSelectedLayer(QPainter& painter, const QRect& exposedRect, const float& zoomFactor, const QPoint& offset);
+    void drawAboveSelectedLayer(QPainter& painter, const QRect& exposedRect, const float& zoomFactor, const QPoint& offset);
+
+    //Zoomed out, draws from the mip level of image nearest zoomFactor so QPainter only scales about screen sized images
+    static void drawCanvasImage(QPainter& painter, const QImage& image, MipPyramid& mipPyramid, const QRect& exposedRect,
+                                const float& zoomFactor, const QPoint& offset);
+
+private:
+    QImage m_belowSelectedLayerImage;
+    QImage m_aboveSelectedLayerImage;
+    QVector<qint64> m_compositesKey;//Of what went into the composites
+
+    MipPyramid m_belowSelectedLayerMips;
+    MipPyramid m_aboveSelectedLayerMips;
+};
+
+#endif // LAYERCOMPOSITOR_H
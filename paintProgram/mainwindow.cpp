@@ -6,6 +6,13 @@
 #include <QKeyEvent>
 #include <QDebug>
 #include <QColor>
+#include <QTimer>
+
+namespace Constants
+{
+//Autosave
+const int DefaultAutosaveIntervalSeconds = 120;
+}
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -49,6 +56,8 @@ MainWindow::MainWindow(QWidget *parent)
 
     m_dlg_hueSaturation = new DLG_HueSaturation(this);
 
+    m_dlg_levels = new DLG_Levels(this);
+
     m_dlg_sketch = new DLG_Sketch(this);
 
     m_dlg_layers = new DLG_Layers(this);
@@ -76,6 +85,9 @@ MainWindow::MainWindow(QWidget *parent)
     connect(m_dlg_hueSaturation, SIGNAL(onHueSaturation(const int, const int)), this, SLOT(onHueSaturation(const int, const int)));
     connect(m_dlg_hueSaturation, SIGNAL(confirmEffects()), this, SLOT(onConfirmEffects()));
     connect(m_dlg_hueSaturation, SIGNAL(cancelEffects()), this, SLOT(onCancelEffects()));
+    connect(m_dlg_levels, SIGNAL(onLevels(const int, const int, const int, const int, const int)), this, SLOT(onLevels(const int, const int, const int, const int, const int)));
+    connect(m_dlg_levels, SIGNAL(confirmEffects()), this, SLOT(onConfirmEffects()));
+    connect(m_dlg_levels, SIGNAL(cancelEffects()), this, SLOT(onCancelEffects()));
     connect(m_dlg_sketch, SIGNAL(onOutlineEffect(const int)), this, SLOT(onOutlineEffect(const int)));
     connect(m_dlg_sketch, SIGNAL(onSketchEffect(const int)), this, SLOT(onSketchEffect(const int)));
     connect(m_dlg_sketch, SIGNAL(confirmEffects()), this, SLOT(onConfirmEffects()));
@@ -107,6 +119,7 @@ MainWindow::MainWindow(QWidget *parent)
     connect(ui->actionBlur, SIGNAL(triggered()), this, SLOT(onShowBlurDialog()));
     connect(ui->actionMultipliers, SIGNAL(triggered()), this, SLOT(onShowColorMultipliersDialog()));
     connect(ui->actionHue_Saturation, SIGNAL(triggered()), this, SLOT(onShowHueSaturationDialog()));
+    connect(ui->actionLevels, SIGNAL(triggered()), this, SLOT(onShowLevelsDialog()));
     connect(ui->actionSketch_Outline, SIGNAL(triggered()), this, SLOT(onSketchAndOutline()));
     connect(ui->action_showInfoDialog, SIGNAL(triggered()), this, SLOT(onShowInfoDialog()));
     connect(ui->action_showLayersDialog, SIGNAL(triggered()), this, SLOT(onShowLayersDialog()));
@@ -116,6 +129,11 @@ MainWindow::MainWindow(QWidget *parent)
     connect(ui->actionLoad_layer, SIGNAL(triggered()), this, SLOT(onLoadLayer()));
     connect(ui->actionExport, SIGNAL(triggered()), this, SLOT(onExportImage()));
 
+    //Autosave
+    m_pAutosaveTimer = new QTimer(this);
+    connect(m_pAutosaveTimer, SIGNAL(timeout()), this, SLOT(onAutosave()));
+    setAutosaveInterval(Constants::DefaultAutosaveIntervalSeconds);
+
     showMaximized();
 
     m_bMakingNewCanvas = true;
@@ -364,6 +382,8 @@ void MainWindow::repositionDialogs() //todo ~ do this based of percentages that
         m_dlg_colorMultipliers->move(geometry().center().x() - (geometry().center().x() - geometry().left())/2 - m_dlg_colorMultipliers->geometry().width()/2, geometry().top());
 
         m_dlg_hueSaturation->move(geometry().center().x() - (geometry().center().x() - geometry().left())/2 - m_dlg_hueSaturation->geometry().width()/2, geometry().top());
+
+        m_dlg_levels->move(geometry().center().x() - (geometry().center().x() - geometry().left())/2 - m_dlg_levels->geometry().width()/2, geometry().top());
     }
 }
 
@@ -539,6 +559,11 @@ void MainWindow::onShowHueSaturationDialog()
     m_dlg_hueSaturation->show();
 }
 
+void MainWindow::onShowLevelsDialog()
+{
+    m_dlg_levels->show();
+}
+
 void MainWindow::onSketchAndOutline()
 {
     m_dlg_sketch->show();
@@ -635,6 +660,19 @@ void MainWindow::onHueSaturation(const int hue, const int saturation)
     }
 }
 
+void MainWindow::onLevels(const int inputBlack, const int inputWhite, const int gamma, const int outputBlack, const int outputWhite)
+{
+    Canvas* c = dynamic_cast<Canvas*>(ui->c_tabWidget->currentWidget());
+    if(c)
+    {
+        c->onLevels(inputBlack, inputWhite, gamma, outputBlack, outputWhite);
+    }
+    else
+    {
+        qDebug() << "MainWindow::onLevels - cant find canvas!";
+    }
+}
+
 void MainWindow::onConfirmEffects()
 {
     Canvas* c = dynamic_cast<Canvas*>(ui->c_tabWidget->currentWidget());
@@ -771,6 +809,8 @@ void MainWindow::addNewCanvas(Canvas *c, QString name)
     connect(c, SIGNAL(selectionAreaResize(const int, const int)), m_dlg_info, SLOT(onSelectionAreaResize(const int, const int)));
     connect(c, SIGNAL(mousePositionChange(const int, const int)), m_dlg_info, SLOT(onMousePositionChange(const int, const int)));
     connect(c, SIGNAL(canvasSizeChange(const int, const int)), m_dlg_info, SLOT(onCanvasSizeChange(const int, const int)));
+    connect(c, SIGNAL(historyMemoryChange(const qint64)), m_dlg_info, SLOT(onHistoryMemoryChange(const qint64)));
+    connect(c, SIGNAL(saveFinished(const QString, const bool)), this, SLOT(onCanvasSaveFinished(const QString, const bool)));
 
     const int index = ui->c_tabWidget->addTab(c, name);
     c->onAddedToTab();
@@ -904,7 +944,43 @@ void MainWindow::saveCanvas(Canvas *canvas, QString path)
 {
     qDebug() << "MainWindow::saveCanvas:";
     qDebug() << path;
-    qDebug() << (canvas->save(path) ? "Saved image" : "Failed to save image");
+    canvas->save(path);
+}
+
+void MainWindow::onCanvasSaveFinished(const QString path, const bool success)
+{
+    qDebug() << "MainWindow::onCanvasSaveFinished:";
+    qDebug() << path;
+    qDebug() << (success ? "Saved image" : "Failed to save image");
+
+    if(!success)
+    {
+        m_dlg_message->show("Failed to save " + path);
+    }
+}
+
+void MainWindow::setAutosaveInterval(const int seconds)
+{
+    if(seconds > 0)
+    {
+        m_pAutosaveTimer->start(seconds * 1000);
+    }
+    else
+    {
+        m_pAutosaveTimer->stop();
+    }
+}
+
+void MainWindow::onAutosave()
+{
+    for(int i = 0; i < ui->c_tabWidget->count(); i++)
+    {
+        Canvas* c = dynamic_cast<Canvas*>(ui->c_tabWidget->widget(i));
+        if(c)
+        {
+            c->autosave();
+        }
+    }
 }
 
 void MainWindow::onOpenColorPicker()
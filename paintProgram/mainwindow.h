@@ -20,6 +20,7 @@
 #include "dlg_blursettings.h"
 #include "dlg_colormultipliers.h"
 #include "dlg_huesaturation.h"
+#include "dlg_levels.h"
 
 #include "canvas.h"
 
@@ -59,6 +60,9 @@ public:
     ///Access mainwindow properties
     bool isCtrlPressed();
 
+    ///Autosave (seconds <= 0 turns it off)
+    void setAutosaveInterval(const int seconds);
+
 protected: //todo - can remove the key events because event filter handles them....
     bool eventFilter(QObject* watched, QEvent* event ) override;
     void resizeEvent(QResizeEvent* event) override;
@@ -81,6 +85,8 @@ private slots:
     void onSave();
     void onSaveAs();
     void onExportImage();
+    void onCanvasSaveFinished(const QString path, const bool success);
+    void onAutosave();
     void onAddTabClicked();
     void onGetCanvasSettings(int width, int height, QString name);
     void onShowCanvasSettings();
@@ -103,6 +109,7 @@ private slots:
     void onShowBlurDialog();
     void onShowColorMultipliersDialog();
     void onShowHueSaturationDialog();
+    void onShowLevelsDialog();
     void onSketchAndOutline();
     void onBrightness(const int value);
     void onContrast(const int value);
@@ -114,6 +121,7 @@ private slots:
                             const int blueXred, const int blueXgreen, const int blueXblue,
                             const int xTransparent);
     void onHueSaturation(const int hue, const int saturation);
+    void onLevels(const int inputBlack, const int inputWhite, const int gamma, const int outputBlack, const int outputWhite);
     void onConfirmEffects();
     void onCancelEffects();
 
@@ -146,6 +154,7 @@ private:
     DLG_EffectsSliders* m_dlg_effectsSliders = nullptr;
     DLG_ColorMultipliers* m_dlg_colorMultipliers = nullptr;
     DLG_HueSaturation* m_dlg_hueSaturation = nullptr;
+    DLG_Levels* m_dlg_levels = nullptr;
     DLG_BlurSettings* m_dlg_blurSettings = nullptr;
     DLG_Sketch* m_dlg_sketch = nullptr;
     DLG_Layers* m_dlg_layers = nullptr;
@@ -162,6 +171,7 @@ private:
     ///Saving
     QString getSaveAsPath(QString name);
     void saveCanvas(Canvas* canvas, QString path);
+    QTimer* m_pAutosaveTimer = nullptr;
 
     ///Positioning
     void repositionDialogs();
@@ -0,0 +1,138 @@
+#include "mippyramid.h"
+
+#include "pixelkernels.h"
+
+#include <algorithm>
+
+namespace Constants
+{
+//Levels are only built while halving still leaves a useful image
+const int MaxMipLevel = 12;
+}
+
+//Average of 4 channel values of premultiplied pixels
+inline QRgb averagePremultiplied(const QRgb a, const QRgb b, const QRgb c, const QRgb d)
+{
+    return qRgba((qRed(a) + qRed(b) + qRed(c) + qRed(d) + 2) / 4,
+                 (qGreen(a) + qGreen(b) + qGreen(c) + qGreen(d) + 2) / 4,
+                 (qBlue(a) + qBlue(b) + qBlue(c) + qBlue(d) + 2) / 4,
+                 (qAlpha(a) + qAlpha(b) + qAlpha(c) + qAlpha(d) + 2) / 4);
+}
+
+//Sets destRect of dest (half the size of source, rounded up) to 2x2 box averages of source. Pixels past the
+//  right/bottom edge of an odd sized source repeat the edge.
+void downsampleRect(const QImage& source, QImage& dest, const QRect& destRect)
+{
+    const bool premultiplySource = source.format() != QImage::Format_ARGB32_Premultiplied;
+    const int sourceRight = source.width() - 1;
+    const int sourceBottom = source.height() - 1;
+    const uchar* sourceBits = source.constBits();
+    const qsizetype sourceBytesPerLine = source.bytesPerLine();
+    uchar* destBits = dest.bits();//Detach before going across threads
+    const qsizetype destBytesPerLine = dest.bytesPerLine();
+
+    PixelKernels::operateOnRowBandsConcurrent(destRect.width(), destRect.height(), [&](const int firstRow, const int endRow)-> void
+    {
+        for(int y = destRect.top() + firstRow; y < destRect.top() + endRow; y++)
+        {
+            const QRgb* topLine = reinterpret_cast<const QRgb*>(sourceBits + (y * 2) * sourceBytesPerLine);
+            const QRgb* bottomLine = reinterpret_cast<const QRgb*>(sourceBits + std::min(y * 2 + 1, sourceBottom) * sourceBytesPerLine);
+            QRgb* destLine = reinterpret_cast<QRgb*>(destBits + y * destBytesPerLine);
+
+            for(int x = destRect.left(); x <= destRect.right(); x++)
+            {
+                const int left = x * 2;
+                const int right = std::min(left + 1, sourceRight);
+                if(premultiplySource)
+                {
+                    destLine[x] = averagePremultiplied(qPremultiply(topLine[left]), qPremultiply(topLine[right]),
+                                                       qPremultiply(bottomLine[left]), qPremultiply(bottomLine[right]));
+                }
+                else
+                {
+                    destLine[x] = averagePremultiplied(topLine[left], topLine[right], bottomLine[left], bottomLine[right]);
+                }
+            }
+        }
+    });
+}
+
+MipPyramid::MipPyramid()
+{
+}
+
+int MipPyramid::levelForZoom(const float& zoomFactor)
+{
+    int level = 0;
+    float levelZoom = zoomFactor;
+    while(levelZoom <= 0.5f && level < Constants::MaxMipLevel)
+    {
+        levelZoom *= 2;
+        level++;
+    }
+    return level;
+}
+
+void MipPyramid::imageEdited(const qint64& oldKey, const qint64& newKey, const QRect& dirtyRect)
+{
+    //Anything else changed since the levels were built means they all need rebuilding anyway
+    if(oldKey != m_sourceKey)
+    {
+        return;
+    }
+
+    m_sourceKey = newKey;
+    m_dirtyRect |= dirtyRect;
+}
+
+int MipPyramid::sync(const QImage& image, const int& level)
+{
+    //Levels are built from scanlines of QRgb
+    const bool isRgbFormat = image.format() == QImage::Format_ARGB32 || image.format() == QImage::Format_ARGB32_Premultiplied || image.format() == QImage::Format_RGB32;
+    const QImage rgbImage = isRgbFormat ? image : image.convertToFormat(QImage::Format_ARGB32);
+
+    if(image.cacheKey() != m_sourceKey || image.size() != m_sourceSize)
+    {
+        m_levels.clear();
+    }
+    else if(!m_dirtyRect.isEmpty())
+    {
+        rebuildRect(rgbImage, m_dirtyRect.intersected(image.rect()));
+    }
+    m_sourceKey = image.cacheKey();
+    m_sourceSize = image.size();
+    m_dirtyRect = QRect();
+
+    //Build any missing levels
+    while(m_levels.size() < level)
+    {
+        const QImage& source = m_levels.isEmpty() ? rgbImage : m_levels.last();
+        if(source.width() <= 1 && source.height() <= 1)
+        {
+            break;
+        }
+
+        QImage levelImage = QImage(QSize((source.width() + 1) / 2, (source.height() + 1) / 2), QImage::Format_ARGB32_Premultiplied);
+        downsampleRect(source, levelImage, levelImage.rect());
+        m_levels.push_back(levelImage);
+    }
+
+    return std::min(level, int(m_levels.size()));
+}
+
+const QImage& MipPyramid::level(const int& level) const
+{
+    return m_levels[level - 1];
+}
+
+void MipPyramid::rebuildRect(const QImage& image, const QRect& rect)
+{
+    QRect levelRect = rect;
+    for(int i = 0; i < m_levels.size() && !levelRect.isEmpty(); i++)
+    {
+        const QImage& source = i == 0 ? image : m_levels[i - 1];
+        levelRect = QRect(QPoint(levelRect.left() / 2, levelRect.top() / 2), QPoint(levelRect.right() / 2, levelRect.bottom() / 2))
+                        .intersected(m_levels[i].rect());
+        downsampleRect(source, m_levels[i], levelRect);
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef MIPPYRAMID_H
+#define MIPPYRAMID_H
+
+#include <QImage>
+#include <QVector>
+#include <QRect>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// MipPyramid
+///
+///Successively halved (2x2 box filtered, Format_ARGB32_Premultiplied) copies of an image, so a zoomed out canvas can
+///  be drawn from a level close to screen size instead of QPainter downsampling the full image every paint.
+///  Level 0 is the image itself. Levels are kept up to date by comparing QImage::cacheKey with the image they were
+///  built from - a changed image is rebuilt, unless imageEdited() said which part of it changed.
+class MipPyramid
+{
+public:
+    MipPyramid();
+
+    //Level to draw at zoomFactor - the smallest one still at least zoomFactor of the image size
+    static int levelForZoom(const float& zoomFactor);
+
+    //Records that the image went from cacheKey oldKey to newKey by changes inside dirtyRect only. If the levels
+    //  were up to date with oldKey, the next sync only rebuilds dirtyRect of them.
+    void imageEdited(const qint64& oldKey, const qint64& newKey, const QRect& dirtyRect);
+
+    //Brings levels 1 -> level up to date with image. Returns the level that can be drawn (less than level if
+    //  image is too small to halve that many times)
+    int sync(const QImage& image, const int& level);
+
+    //Only valid for 1 -> the level returned by sync
+    const QImage& level(const int& level) const;
+
+private:
+    void rebuildRect(const QImage& image, const QRect& rect);
+
+    QVector<QImage> m_levels;//m_levels[0] is level 1
+    qint64 m_sourceKey = 0;
+    QSize m_sourceSize;
+    QRect m_dirtyRect = QRect();//Of the image, not yet rebuilt in m_levels
+};
+
+#endif // MIPPYRAMID_H
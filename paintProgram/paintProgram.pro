@@ -1,4 +1,4 @@
-QT       += core gui
+QT       += core gui concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -11,6 +11,7 @@ CONFIG += resources_big
 
 SOURCES += \
     canvas.cpp \
+    canvasfile.cpp \
     dlg_blursettings.cpp \
     dlg_brushsettings.cpp \
     dlg_colormultipliers.cpp \
@@ -18,6 +19,7 @@ SOURCES += \
     dlg_huesaturation.cpp \
     dlg_info.cpp \
     dlg_layers.cpp \
+    dlg_levels.cpp \
     dlg_message.cpp \
     dlg_sensitivity.cpp \
     dlg_setcanvassettings.cpp \
@@ -25,12 +27,20 @@ SOURCES += \
     dlg_sketch.cpp \
     dlg_textsettings.cpp \
     dlg_tools.cpp \
+    effectscheduler.cpp \
+    floodfill.cpp \
+    layercompositor.cpp \
     main.cpp \
     mainwindow.cpp \
+    mippyramid.cpp \
+    pixelkernels.cpp \
+    selectionmask.cpp \
+    tiledimage.cpp \
     wdg_layerlistitem.cpp
 
 HEADERS += \
     canvas.h \
+    canvasfile.h \
     canvaslayer.h \
     dlg_blursettings.h \
     dlg_brushsettings.h \
@@ -39,6 +49,7 @@ HEADERS += \
     dlg_huesaturation.h \
     dlg_info.h \
     dlg_layers.h \
+    dlg_levels.h \
     dlg_message.h \
     dlg_sensitivity.h \
     dlg_setcanvassettings.h \
@@ -46,7 +57,14 @@ HEADERS += \
     dlg_sketch.h \
     dlg_textsettings.h \
     dlg_tools.h \
+    effectscheduler.h \
+    floodfill.h \
+    layercompositor.h \
     mainwindow.h \
+    mippyramid.h \
+    pixelkernels.h \
+    selectionmask.h \
+    tiledimage.h \
     tools.h \
     wdg_layerlistitem.h
 
@@ -58,6 +76,7 @@ FORMS += \
     dlg_huesaturation.ui \
     dlg_info.ui \
     dlg_layers.ui \
+    dlg_levels.ui \
     dlg_message.ui \
     dlg_sensitivity.ui \
     dlg_setcanvassettings.ui \
@@ -0,0 +1,674 @@
+#include "pixelkernels.h"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PIXELKERNELS_X86
+#endif
+
+#ifdef PIXELKERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+//Lets AVX2 functions compile without building the whole file with -mavx2 (MSVC doesnt need it)
+#if defined(__GNUC__) || defined(__clang__)
+#define PIXELKERNELS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PIXELKERNELS_TARGET_AVX2
+#endif
+
+namespace Constants
+{
+//adjust() runs each adjustment over this many pixels (16KB) at a time
+const int AdjustChunkPixels = 4096;
+}
+
+namespace PixelKernels
+{
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Cpu detection
+///
+SimdLevel detectedSimdLevel()
+{
+#ifdef PIXELKERNELS_X86
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return SimdLevel::AVX2;
+    }
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if(info[0] >= 7)
+    {
+        __cpuid(info, 1);
+        const bool osUsesXSave = (info[2] & (1 << 27)) != 0;
+        const bool cpuHasAvx = (info[2] & (1 << 28)) != 0;
+
+        __cpuidex(info, 7, 0);
+        const bool cpuHasAvx2 = (info[1] & (1 << 5)) != 0;
+
+        //Check the os saves the ymm registers too
+        if(osUsesXSave && cpuHasAvx && cpuHasAvx2 && (_xgetbv(0) & 0x6) == 0x6)
+        {
+            return SimdLevel::AVX2;
+        }
+    }
+#endif
+    return SimdLevel::SSE2;//Always there on x86_64
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+namespace
+{
+SimdLevel currentSimdLevel = detectedSimdLevel();
+}
+
+const std::atomic<bool>*& currentCancelFlag()
+{
+    static thread_local const std::atomic<bool>* cancelFlag = nullptr;
+    return cancelFlag;
+}
+
+SimdLevel simdLevel()
+{
+    return currentSimdLevel;
+}
+
+void setSimdLevel(const SimdLevel level)
+{
+    //Cant go above what the cpu supports
+    currentSimdLevel = int(level) < int(detectedSimdLevel()) ? level : detectedSimdLevel();
+}
+
+#ifdef PIXELKERNELS_X86
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// SSE2 - 4 pixels at a time
+///
+namespace
+{
+
+const QRgb AlphaMask = 0xff000000;
+const QRgb RgbMask = 0x00ffffff;
+
+//Keeps alpha of original, rgb of changed
+inline __m128i keepAlphaSSE2(const __m128i original, const __m128i changed)
+{
+    const __m128i alphaMask = _mm_set1_epi32(int(AlphaMask));
+    return _mm_or_si128(_mm_and_si128(original, alphaMask), _mm_andnot_si128(alphaMask, changed));
+}
+
+void greyScaleSSE2(QRgb* line, const int width, int& x)
+{
+    const __m128i channelMask = _mm_set1_epi32(0xff);
+    const __m128i oneThird = _mm_set1_epi32(0xaaab);//(sum * 0xaaab) >> 17 == sum / 3 for sums of up to 3 * 255
+    for(; x + 4 <= width; x += 4)
+    {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line + x));
+        const __m128i sum = _mm_add_epi32(_mm_add_epi32(_mm_and_si128(pixels, channelMask),
+                                                        _mm_and_si128(_mm_srli_epi32(pixels, 8), channelMask)),
+                                          _mm_and_si128(_mm_srli_epi32(pixels, 16), channelMask));
+
+        //Sum fits in the low 16 bits of each 32 bit lane, top 16 bits are zero so stay zero
+        const __m128i grey = _mm_srli_epi32(_mm_mulhi_epu16(sum, oneThird), 1);
+        const __m128i rgb = _mm_or_si128(_mm_or_si128(grey, _mm_slli_epi32(grey, 8)), _mm_slli_epi32(grey, 16));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(line + x), keepAlphaSSE2(pixels, rgb));
+    }
+}
+
+void invertSSE2(QRgb* line, const int width, int& x)
+{
+    const __m128i rgbMask = _mm_set1_epi32(int(RgbMask));
+    for(; x + 4 <= width; x += 4)
+    {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line + x));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(line + x), _mm_xor_si128(pixels, rgbMask));
+    }
+}
+
+void changeBrightnessSSE2(QRgb* line, const int width, const int value, int& x)
+{
+    //Saturating byte add/sub does the 0-255 clamp. Alpha byte gets 0 so is unchanged
+    const int amount = value < 0 ? (-value > MaxRgbValue ? MaxRgbValue : -value) : (value > MaxRgbValue ? MaxRgbValue : value);
+    const __m128i change = _mm_set1_epi32(int(qRgba(amount, amount, amount, 0)));
+    for(; x + 4 <= width; x += 4)
+    {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line + x));
+        const __m128i result = value < 0 ? _mm_subs_epu8(pixels, change) : _mm_adds_epu8(pixels, change);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(line + x), result);
+    }
+}
+
+void changeContrastSSE2(QRgb* line, const int width, const int value, int& x)
+{
+    const int amount = value < 0 ? (-value > MaxRgbValue ? MaxRgbValue : -value) : (value > MaxRgbValue ? MaxRgbValue : value);
+    const __m128i change = _mm_set1_epi8(char(amount));
+    const __m128i middle = _mm_set1_epi8(char(MiddleRgbValue));
+    const __m128i aboveMiddleMin = _mm_set1_epi8(char(MiddleRgbValue + 1));
+    for(; x + 4 <= width; x += 4)
+    {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line + x));
+
+        //Channels above, below and on the middle value
+        const __m128i isAbove = _mm_cmpeq_epi8(_mm_max_epu8(pixels, aboveMiddleMin), pixels);
+        const __m128i isMiddle = _mm_cmpeq_epi8(pixels, middle);
+        const __m128i isBelow = _mm_andnot_si128(_mm_or_si128(isAbove, isMiddle), _mm_set1_epi8(char(0xff)));
+
+        __m128i above;
+        __m128i below;
+        if(value > 0)
+        {
+            //Move away from middle, clamped to 0-255
+            above = _mm_adds_epu8(pixels, change);
+            below = _mm_subs_epu8(pixels, change);
+        }
+        else
+        {
+            //Move towards middle, not past it
+            above = _mm_max_epu8(_mm_subs_epu8(pixels, change), middle);
+            below = _mm_min_epu8(_mm_adds_epu8(pixels, change), middle);
+        }
+
+        const __m128i result = _mm_or_si128(_mm_or_si128(_mm_and_si128(isAbove, above), _mm_and_si128(isBelow, below)),
+                                            _mm_and_si128(isMiddle, pixels));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(line + x), keepAlphaSSE2(pixels, result));
+    }
+}
+
+void colorMultipliersSSE2(QRgb* line, const int width, const ColorMultipliers& m, int& x)
+{
+    const __m128i channelMask = _mm_set1_epi32(0xff);
+    const __m128i maxRgb = _mm_set1_epi32(MaxRgbValue);
+    for(; x + 4 <= width; x += 4)
+    {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line + x));
+        const __m128 blue = _mm_cvtepi32_ps(_mm_and_si128(pixels, channelMask));
+        const __m128 green = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 8), channelMask));
+        const __m128 red = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 16), channelMask));
+        const __m128 alpha = _mm_cvtepi32_ps(_mm_srli_epi32(pixels, 24));
+
+        //Same operation order as colorMultipliersPixel (mul, mul, add, mul, add - no fma) so float results match exactly
+        const auto combine = [&](const float xRed, const float xGreen, const float xBlue)-> __m128i
+        {
+            const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(red, _mm_set1_ps(xRed)), _mm_mul_ps(green, _mm_set1_ps(xGreen))),
+                                          _mm_mul_ps(blue, _mm_set1_ps(xBlue)));
+            const __m128i truncated = _mm_cvttps_epi32(sum);
+
+            //No _mm_min_epi32 in SSE2
+            const __m128i tooBig = _mm_cmpgt_epi32(truncated, maxRgb);
+            return _mm_or_si128(_mm_and_si128(tooBig, maxRgb), _mm_andnot_si128(tooBig, truncated));
+        };
+
+        const __m128i newR = combine(m.redXred, m.redXgreen, m.redXblue);
+        const __m128i newG = combine(m.greenXred, m.greenXgreen, m.greenXblue);
+        const __m128i newB = combine(m.blueXred, m.blueXgreen, m.blueXblue);
+        const __m128i newA = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(alpha, _mm_set1_ps(m.xTransparent))), channelMask);
+
+        const __m128i result = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(newA, 24), _mm_slli_epi32(newR, 16)),
+                                            _mm_or_si128(_mm_slli_epi32(newG, 8), newB));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(line + x), result);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// AVX2 - 8 pixels at a time. Same steps as the SSE2 versions
+///
+PIXELKERNELS_TARGET_AVX2 inline __m256i keepAlphaAVX2(const __m256i original, const __m256i changed)
+{
+    const __m256i alphaMask = _mm256_set1_epi32(int(AlphaMask));
+    return _mm256_blendv_epi8(changed, original, alphaMask);
+}
+
+PIXELKERNELS_TARGET_AVX2 void greyScaleAVX2(QRgb* line, const int width, int& x)
+{
+    const __m256i channelMask = _mm256_set1_epi32(0xff);
+    const __m256i oneThird = _mm256_set1_epi32(0xaaab);
+    for(; x + 8 <= width; x += 8)
+    {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(line + x));
+        const __m256i sum = _mm256_add_epi32(_mm256_add_epi32(_mm256_and_si256(pixels, channelMask),
+                                                              _mm256_and_si256(_mm256_srli_epi32(pixels, 8), channelMask)),
+                                             _mm256_and_si256(_mm256_srli_epi32(pixels, 16), channelMask));
+        const __m256i grey = _mm256_srli_epi32(_mm256_mulhi_epu16(sum, oneThird), 1);
+        const __m256i rgb = _mm256_or_si256(_mm256_or_si256(grey, _mm256_slli_epi32(grey, 8)), _mm256_slli_epi32(grey, 16));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(line + x), keepAlphaAVX2(pixels, rgb));
+    }
+}
+
+PIXELKERNELS_TARGET_AVX2 void invertAVX2(QRgb* line, const int width, int& x)
+{
+    const __m256i rgbMask = _mm256_set1_epi32(int(RgbMask));
+    for(; x + 8 <= width; x += 8)
+    {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(line + x));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(line + x), _mm256_xor_si256(pixels, rgbMask));
+    }
+}
+
+PIXELKERNELS_TARGET_AVX2 void changeBrightnessAVX2(QRgb* line, const int width, const int value, int& x)
+{
+    const int amount = value < 0 ? (-value > MaxRgbValue ? MaxRgbValue : -value) : (value > MaxRgbValue ? MaxRgbValue : value);
+    const __m256i change = _mm256_set1_epi32(int(qRgba(amount, amount, amount, 0)));
+    for(; x + 8 <= width; x += 8)
+    {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(line + x));
+        const __m256i result = value < 0 ? _mm256_subs_epu8(pixels, change) : _mm256_adds_epu8(pixels, change);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(line + x), result);
+    }
+}
+
+PIXELKERNELS_TARGET_AVX2 void changeContrastAVX2(QRgb* line, const int width, const int value, int& x)
+{
+    const int amount = value < 0 ? (-value > MaxRgbValue ? MaxRgbValue : -value) : (value > MaxRgbValue ? MaxRgbValue : value);
+    const __m256i change = _mm256_set1_epi8(char(amount));
+    const __m256i middle = _mm256_set1_epi8(char(MiddleRgbValue));
+    const __m256i aboveMiddleMin = _mm256_set1_epi8(char(MiddleRgbValue + 1));
+    for(; x + 8 <= width; x += 8)
+    {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(line + x));
+        const __m256i isAbove = _mm256_cmpeq_epi8(_mm256_max_epu8(pixels, aboveMiddleMin), pixels);
+        const __m256i isMiddle = _mm256_cmpeq_epi8(pixels, middle);
+
+        __m256i above;
+        __m256i below;
+        if(value > 0)
+        {
+            above = _mm256_adds_epu8(pixels, change);
+            below = _mm256_subs_epu8(pixels, change);
+        }
+        else
+        {
+            above = _mm256_max_epu8(_mm256_subs_epu8(pixels, change), middle);
+            below = _mm256_min_epu8(_mm256_adds_epu8(pixels, change), middle);
+        }
+
+        const __m256i result = _mm256_blendv_epi8(_mm256_blendv_epi8(below, above, isAbove), pixels, isMiddle);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(line + x), keepAlphaAVX2(pixels, result));
+    }
+}
+
+//No fma here either, would round differently to the scalar version
+PIXELKERNELS_TARGET_AVX2 inline __m256i colorMultiplierAVX2(const __m256 red, const __m256 green, const __m256 blue, const float xRed, const float xGreen, const float xBlue)
+{
+    const __m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(red, _mm256_set1_ps(xRed)), _mm256_mul_ps(green, _mm256_set1_ps(xGreen))),
+                                     _mm256_mul_ps(blue, _mm256_set1_ps(xBlue)));
+    return _mm256_min_epi32(_mm256_cvttps_epi32(sum), _mm256_set1_epi32(MaxRgbValue));
+}
+
+PIXELKERNELS_TARGET_AVX2 void colorMultipliersAVX2(QRgb* line, const int width, const ColorMultipliers& m, int& x)
+{
+    const __m256i channelMask = _mm256_set1_epi32(0xff);
+    for(; x + 8 <= width; x += 8)
+    {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(line + x));
+        const __m256 blue = _mm256_cvtepi32_ps(_mm256_and_si256(pixels, channelMask));
+        const __m256 green = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 8), channelMask));
+        const __m256 red = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 16), channelMask));
+        const __m256 alpha = _mm256_cvtepi32_ps(_mm256_srli_epi32(pixels, 24));
+
+        const __m256i newR = colorMultiplierAVX2(red, green, blue, m.redXred, m.redXgreen, m.redXblue);
+        const __m256i newG = colorMultiplierAVX2(red, green, blue, m.greenXred, m.greenXgreen, m.greenXblue);
+        const __m256i newB = colorMultiplierAVX2(red, green, blue, m.blueXred, m.blueXgreen, m.blueXblue);
+        const __m256i newA = _mm256_and_si256(_mm256_cvttps_epi32(_mm256_mul_ps(alpha, _mm256_set1_ps(m.xTransparent))), channelMask);
+
+        const __m256i result = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(newA, 24), _mm256_slli_epi32(newR, 16)),
+                                               _mm256_or_si256(_mm256_slli_epi32(newG, 8), newB));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(line + x), result);
+    }
+}
+
+
+//Exact numerator / denominator (rounded down) for non negative numerators and quotients below 2^20 - the float
+//  estimate is at most 1 out, which the remainder corrects. Integer division has no SIMD instruction.
+PIXELKERNELS_TARGET_AVX2 inline __m256i divideAVX2(const __m256i numerator, const __m256i denominator)
+{
+    const __m256i estimate = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(numerator), _mm256_cvtepi32_ps(denominator)));
+    const __m256i remainder = _mm256_sub_epi32(numerator, _mm256_mullo_epi32(estimate, denominator));
+    const __m256i tooHigh = _mm256_cmpgt_epi32(_mm256_setzero_si256(), remainder);
+    const __m256i tooLow = _mm256_cmpgt_epi32(remainder, _mm256_sub_epi32(denominator, _mm256_set1_epi32(1)));
+    return _mm256_sub_epi32(_mm256_add_epi32(estimate, tooHigh), tooLow);//Masks are -1 where set
+}
+
+PIXELKERNELS_TARGET_AVX2 inline __m256i div257AVX2(const __m256i value)
+{
+    return _mm256_srli_epi32(_mm256_add_epi32(_mm256_sub_epi32(value, _mm256_srli_epi32(value, 8)), _mm256_set1_epi32(0x80)), 8);
+}
+
+//round(value16 * (scale - subtract) / scale) -> 8 bit, as in hueAndSaturationPixel
+PIXELKERNELS_TARGET_AVX2 inline __m256i hsvChannelAVX2(const __m256i value16, const __m256i subtract, const int scale)
+{
+    const __m256i numerator = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_add_epi32(value16, value16), _mm256_sub_epi32(_mm256_set1_epi32(scale), subtract)),
+                                               _mm256_set1_epi32(scale));
+    return div257AVX2(divideAVX2(numerator, _mm256_set1_epi32(2 * scale)));
+}
+
+PIXELKERNELS_TARGET_AVX2 inline __m256i selectAVX2(const __m256i mask, const __m256i ifSet, const __m256i otherwise)
+{
+    return _mm256_blendv_epi8(otherwise, ifSet, mask);
+}
+
+//Same integer steps as hueAndSaturationPixel, so same results
+PIXELKERNELS_TARGET_AVX2 void hueAndSaturationAVX2(QRgb* line, const int width, const int hue, const int saturation, int& x)
+{
+    const __m256i channelMask = _mm256_set1_epi32(0xff);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    for(; x + 8 <= width; x += 8)
+    {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(line + x));
+        const __m256i blue = _mm256_and_si256(pixels, channelMask);
+        const __m256i green = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), channelMask);
+        const __m256i red = _mm256_and_si256(_mm256_srli_epi32(pixels, 16), channelMask);
+        const __m256i alpha = _mm256_srli_epi32(pixels, 24);
+
+        const __m256i maxChannel = _mm256_max_epi32(red, _mm256_max_epi32(green, blue));
+        const __m256i minChannel = _mm256_min_epi32(red, _mm256_min_epi32(green, blue));
+        const __m256i delta = _mm256_sub_epi32(maxChannel, minChannel);
+        const __m256i grey = _mm256_cmpeq_epi32(delta, zero);
+        const __m256i deltaOr1 = _mm256_max_epi32(delta, one);//Grey lanes are overwritten, just avoid dividing by 0
+
+        //QColor::getHsv
+        const __m256i s = div257AVX2(divideAVX2(_mm256_add_epi32(_mm256_mullo_epi32(delta, _mm256_set1_epi32(2 * 65535)), maxChannel),
+                                                _mm256_add_epi32(_mm256_max_epi32(maxChannel, one), _mm256_max_epi32(maxChannel, one))));
+
+        const __m256i sixThousand = _mm256_set1_epi32(6000);
+        const __m256i redNumerator = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(green, blue), sixThousand),
+                                                      _mm256_and_si256(_mm256_cmpgt_epi32(blue, green), _mm256_mullo_epi32(delta, _mm256_set1_epi32(36000))));
+        const __m256i greenNumerator = _mm256_add_epi32(_mm256_mullo_epi32(delta, _mm256_set1_epi32(12000)), _mm256_mullo_epi32(_mm256_sub_epi32(blue, red), sixThousand));
+        const __m256i blueNumerator = _mm256_add_epi32(_mm256_mullo_epi32(delta, _mm256_set1_epi32(24000)), _mm256_mullo_epi32(_mm256_sub_epi32(red, green), sixThousand));
+        const __m256i hueNumerator = selectAVX2(_mm256_cmpeq_epi32(red, maxChannel), redNumerator,
+                                                selectAVX2(_mm256_cmpeq_epi32(green, maxChannel), greenNumerator, blueNumerator));
+        const __m256i hue100 = divideAVX2(_mm256_add_epi32(_mm256_add_epi32(hueNumerator, hueNumerator), delta), _mm256_add_epi32(deltaOr1, deltaOr1));
+        const __m256i h = selectAVX2(grey, _mm256_set1_epi32(-1), divideAVX2(hue100, _mm256_set1_epi32(100)));
+
+        const __m256i newHue = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(h, _mm256_set1_epi32(hue)), _mm256_set1_epi32(MinHue)), _mm256_set1_epi32(MaxHue));
+        const __m256i newSaturation = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(s, _mm256_set1_epi32(saturation)), _mm256_set1_epi32(MinSaturation)), _mm256_set1_epi32(MaxSaturation));
+
+        //QColor::fromHsv. No special case for 0 saturation, p, q & t all come out as value.
+        const __m256i sector = divideAVX2(newHue, _mm256_set1_epi32(60));
+        const __m256i sectorDegrees = _mm256_sub_epi32(newHue, _mm256_mullo_epi32(sector, _mm256_set1_epi32(60)));
+        const __m256i value16 = _mm256_mullo_epi32(maxChannel, _mm256_set1_epi32(257));
+        const __m256i p = hsvChannelAVX2(value16, newSaturation, MaxRgbValue);
+        const __m256i q = hsvChannelAVX2(value16, _mm256_mullo_epi32(newSaturation, sectorDegrees), 15300);
+        const __m256i t = hsvChannelAVX2(value16, _mm256_mullo_epi32(newSaturation, _mm256_sub_epi32(_mm256_set1_epi32(60), sectorDegrees)), 15300);
+
+        const __m256i sector0 = _mm256_cmpeq_epi32(sector, zero);
+        const __m256i sector1 = _mm256_cmpeq_epi32(sector, one);
+        const __m256i sector2 = _mm256_cmpeq_epi32(sector, _mm256_set1_epi32(2));
+        const __m256i sector3 = _mm256_cmpeq_epi32(sector, _mm256_set1_epi32(3));
+        const __m256i sector4 = _mm256_cmpeq_epi32(sector, _mm256_set1_epi32(4));
+        const __m256i newRed = selectAVX2(_mm256_or_si256(sector2, sector3), p, selectAVX2(sector1, q, selectAVX2(sector4, t, maxChannel)));
+        const __m256i newGreen = selectAVX2(_mm256_or_si256(sector1, sector2), maxChannel, selectAVX2(sector0, t, selectAVX2(sector3, q, p)));
+        const __m256i newBlue = selectAVX2(_mm256_or_si256(sector0, sector1), p, selectAVX2(sector2, t, selectAVX2(_mm256_or_si256(sector3, sector4), maxChannel, q)));
+
+        const __m256i result = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(alpha, 24), _mm256_slli_epi32(newRed, 16)),
+                                               _mm256_or_si256(_mm256_slli_epi32(newGreen, 8), newBlue));
+
+        //Fully transparent pixels are left alone
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(line + x), selectAVX2(_mm256_cmpeq_epi32(alpha, zero), pixels, result));
+    }
+}
+
+}
+
+#endif //PIXELKERNELS_X86
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Channel lookup tables
+///
+ChannelLut identityLut()
+{
+    ChannelLut lut;
+    for(int i = MinRgbValue; i <= MaxRgbValue; i++)
+    {
+        lut.values[i] = uchar(i);
+    }
+    return lut;
+}
+
+ChannelLut brightnessLut(const int value)
+{
+    ChannelLut lut;
+    for(int i = MinRgbValue; i <= MaxRgbValue; i++)
+    {
+        lut.values[i] = uchar(limitValidRgb(i + value));
+    }
+    return lut;
+}
+
+ChannelLut contrastLut(const int value)
+{
+    ChannelLut lut;
+    for(int i = MinRgbValue; i <= MaxRgbValue; i++)
+    {
+        lut.values[i] = uchar(changeContrastRGOB(i, value));
+    }
+    return lut;
+}
+
+ChannelLut levelsLut(const Levels& levels)
+{
+    const int inputRange = levels.inputWhite - levels.inputBlack;
+    const float inverseGamma = levels.gamma > 0 ? 1 / levels.gamma : 1;
+
+    ChannelLut lut;
+    for(int i = MinRgbValue; i <= MaxRgbValue; i++)
+    {
+        //Position of i between the input black and white points, 0 -> 1
+        float position = inputRange > 0 ? float(i - levels.inputBlack) / inputRange : (i >= levels.inputWhite ? 1 : 0);
+        position = position < 0 ? 0 : (position > 1 ? 1 : position);
+        if(inverseGamma != 1)
+        {
+            position = std::pow(position, inverseGamma);
+        }
+
+        lut.values[i] = uchar(limitValidRgb(qRound(levels.outputBlack + position * (levels.outputWhite - levels.outputBlack))));
+    }
+    return lut;
+}
+
+ChannelLut composedLut(const ChannelLut& first, const ChannelLut& second)
+{
+    ChannelLut lut;
+    for(int i = MinRgbValue; i <= MaxRgbValue; i++)
+    {
+        lut.values[i] = second.values[first.values[i]];
+    }
+    return lut;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Scanline kernels
+///
+///SIMD does as much of the line as it can, then the scalar versions finish off the remaining pixels
+void greyScale(QRgb* line, const int width)
+{
+    int x = 0;
+#ifdef PIXELKERNELS_X86
+    if(currentSimdLevel == SimdLevel::AVX2)
+        greyScaleAVX2(line, width, x);
+    else if(currentSimdLevel == SimdLevel::SSE2)
+        greyScaleSSE2(line, width, x);
+#endif
+    for(; x < width; x++)
+    {
+        line[x] = greyScaleColor(line[x]);
+    }
+}
+
+void invert(QRgb* line, const int width)
+{
+    int x = 0;
+#ifdef PIXELKERNELS_X86
+    if(currentSimdLevel == SimdLevel::AVX2)
+        invertAVX2(line, width, x);
+    else if(currentSimdLevel == SimdLevel::SSE2)
+        invertSSE2(line, width, x);
+#endif
+    for(; x < width; x++)
+    {
+        line[x] = invertColor(line[x]);
+    }
+}
+
+void changeBrightness(QRgb* line, const int width, const int value)
+{
+    int x = 0;
+#ifdef PIXELKERNELS_X86
+    if(currentSimdLevel == SimdLevel::AVX2)
+        changeBrightnessAVX2(line, width, value, x);
+    else if(currentSimdLevel == SimdLevel::SSE2)
+        changeBrightnessSSE2(line, width, value, x);
+#endif
+    for(; x < width; x++)
+    {
+        line[x] = changeBrightness(line[x], value);
+    }
+}
+
+void changeContrast(QRgb* line, const int width, const int value)
+{
+    if(value == 0)
+    {
+        return;
+    }
+
+    int x = 0;
+#ifdef PIXELKERNELS_X86
+    if(currentSimdLevel == SimdLevel::AVX2)
+        changeContrastAVX2(line, width, value, x);
+    else if(currentSimdLevel == SimdLevel::SSE2)
+        changeContrastSSE2(line, width, value, x);
+#endif
+    for(; x < width; x++)
+    {
+        line[x] = changeContrast(line[x], value);
+    }
+}
+
+void colorMultipliers(QRgb* line, const int width, const ColorMultipliers& multipliers)
+{
+    int x = 0;
+#ifdef PIXELKERNELS_X86
+    if(currentSimdLevel == SimdLevel::AVX2)
+        colorMultipliersAVX2(line, width, multipliers, x);
+    else if(currentSimdLevel == SimdLevel::SSE2)
+        colorMultipliersSSE2(line, width, multipliers, x);
+#endif
+    for(; x < width; x++)
+    {
+        line[x] = colorMultipliersPixel(line[x], multipliers);
+    }
+}
+
+//No SSE2 version, it lacks the 32 bit multiply, min/max and blend the integer HSV steps need
+void hueAndSaturation(QRgb* line, const int width, const int hue, const int saturation)
+{
+    int x = 0;
+#ifdef PIXELKERNELS_X86
+    if(currentSimdLevel == SimdLevel::AVX2)
+        hueAndSaturationAVX2(line, width, hue, saturation, x);
+#endif
+    for(; x < width; x++)
+    {
+        line[x] = hueAndSaturationPixel(line[x], hue, saturation);
+    }
+}
+
+void applyLut(QRgb* line, const int width, const ChannelLut& lut)
+{
+    int x = 0;
+    for(; x + 4 <= width; x += 4)
+    {
+        //Independent lookups, so the loads of the 4 pixels overlap
+        const QRgb pixel0 = line[x];
+        const QRgb pixel1 = line[x + 1];
+        const QRgb pixel2 = line[x + 2];
+        const QRgb pixel3 = line[x + 3];
+        line[x] = lutPixel(pixel0, lut);
+        line[x + 1] = lutPixel(pixel1, lut);
+        line[x + 2] = lutPixel(pixel2, lut);
+        line[x + 3] = lutPixel(pixel3, lut);
+    }
+    for(; x < width; x++)
+    {
+        line[x] = lutPixel(line[x], lut);
+    }
+}
+
+PreparedAdjustments prepareAdjustments(const Adjustments& adjustments)
+{
+    PreparedAdjustments prepared;
+
+    const bool levels = !adjustments.levels.isIdentity();
+    prepared.hasChannelLut = adjustments.brightness != 0 || adjustments.contrast != 0 || levels;
+    if(prepared.hasChannelLut)
+    {
+        prepared.channelLut = composedLut(brightnessLut(adjustments.brightness), contrastLut(adjustments.contrast));
+        if(levels)
+        {
+            prepared.channelLut = composedLut(prepared.channelLut, levelsLut(adjustments.levels));
+        }
+        else
+        {
+            prepared.simdBrightness = adjustments.brightness;
+            prepared.simdContrast = adjustments.contrast;
+        }
+    }
+
+    prepared.multiply = !isIdentity(adjustments.multipliers);
+    prepared.multipliers = adjustments.multipliers;
+
+    prepared.hueSaturation = adjustments.hueSaturation || adjustments.hue != 0 || adjustments.saturation != 0;
+    prepared.hue = adjustments.hue;
+    prepared.saturation = adjustments.saturation;
+
+    return prepared;
+}
+
+void adjust(QRgb* line, const int width, const PreparedAdjustments& adjustments)
+{
+    for(int chunkStart = 0; chunkStart < width; chunkStart += Constants::AdjustChunkPixels)
+    {
+        QRgb* chunk = line + chunkStart;
+        const int chunkWidth = width - chunkStart < Constants::AdjustChunkPixels ? width - chunkStart : Constants::AdjustChunkPixels;
+
+        if(adjustments.simdBrightness != 0 || adjustments.simdContrast != 0)
+        {
+            if(adjustments.simdBrightness != 0)
+            {
+                changeBrightness(chunk, chunkWidth, adjustments.simdBrightness);
+            }
+            if(adjustments.simdContrast != 0)
+            {
+                changeContrast(chunk, chunkWidth, adjustments.simdContrast);
+            }
+        }
+        else if(adjustments.hasChannelLut)
+        {
+            applyLut(chunk, chunkWidth, adjustments.channelLut);
+        }
+        if(adjustments.multiply)
+        {
+            colorMultipliers(chunk, chunkWidth, adjustments.multipliers);
+        }
+        if(adjustments.hueSaturation)
+        {
+            hueAndSaturation(chunk, chunkWidth, adjustments.hue, adjustments.saturation);
+        }
+    }
+}
+
+}
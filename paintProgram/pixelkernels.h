@@ -0,0 +1,520 @@
+#ifndef PIXELKERNELS_H
+#define PIXELKERNELS_H
+
+#include <QImage>
+#include <QVector>
+#include <QPoint>
+#include <QtConcurrent>
+#include <atomic>
+
+#include "selectionmask.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// PixelKernels
+///
+///Row by row operations on raw ARGB32 scanlines. Kernels are templated functors (usually lambdas) so the per pixel
+///  call is inlined, unlike going through std::function + pixelColor/setPixelColor for every pixel.
+///Format_ARGB32 is not premultiplied, so a QRgb read from a scanline holds the same values QImage::pixelColor returns.
+namespace PixelKernels
+{
+
+const int MinRgbValue = 0;
+const int MaxRgbValue = 255;
+const int MiddleRgbValue = 127;
+const int MinHue = 0;
+const int MaxHue = 179;
+const int MinSaturation = 0;
+const int MaxSaturation = 255;
+
+//Rough number of pixels each thread is handed at a time by the concurrent operations
+const int PixelsPerRowBand = 1 << 16;
+
+//Converts image to Format_ARGB32 if it isnt already (loaded images can be any format).
+//  Only for images about to be written to - conversion from other formats (ie premultiplied) can lose precision.
+inline void ensureArgb32(QImage& image)
+{
+    if(image.format() != QImage::Format_ARGB32)
+    {
+        image = image.convertToFormat(QImage::Format_ARGB32);
+    }
+}
+
+//For passes that only read image - image keeps its format, the result shares its data if its already Format_ARGB32
+inline QImage toArgb32(const QImage& image)
+{
+    return image.format() == QImage::Format_ARGB32 ? image : image.convertToFormat(QImage::Format_ARGB32);
+}
+
+//Calls scanlineKernel(QRgb* line, int y, int width) for every row of image
+template<typename ScanlineKernel>
+void operateOnScanlines(QImage& image, ScanlineKernel&& scanlineKernel)
+{
+    ensureArgb32(image);
+
+    const int width = image.width();
+    const int height = image.height();
+    const qsizetype bytesPerLine = image.bytesPerLine();
+    uchar* bits = image.bits();//Detaches once, not once per pixel
+
+    for(int y = 0; y < height; y++)
+    {
+        scanlineKernel(reinterpret_cast<QRgb*>(bits + y * bytesPerLine), y, width);
+    }
+}
+
+//Sets every pixel of image to pixelKernel(pixel)
+template<typename PixelKernel>
+void operateOnPixels(QImage& image, PixelKernel&& pixelKernel)
+{
+    operateOnScanlines(image, [&](QRgb* line, const int, const int width)-> void
+    {
+        for(int x = 0; x < width; x++)
+        {
+            line[x] = pixelKernel(line[x]);
+        }
+    });
+}
+
+//Sets every selected pixel to pixelKernel(pixel). Pixels outside of image are ignored (like setPixelColor)
+template<typename PixelKernel>
+void operateOnPixels(QImage& image, const SelectionMask& pixels, PixelKernel&& pixelKernel)
+{
+    ensureArgb32(image);
+
+    const qsizetype bytesPerLine = image.bytesPerLine();
+    uchar* bits = image.bits();
+
+    pixels.forEachSpanInRect(image.rect(), [&](const int y, const int left, const int right)-> void
+    {
+        QRgb* line = reinterpret_cast<QRgb*>(bits + y * bytesPerLine);
+        for(int x = left; x <= right; x++)
+        {
+            line[x] = pixelKernel(line[x]);
+        }
+    });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Cancellation
+///
+///While a CancelScope exists on a thread, concurrent operations started from that thread skip the bands they havnt
+///  started yet once its flag is set. Lets a pass whose result is no longer wanted (ie a stale effect preview) stop
+///  early - the image it was working on is left part done.
+
+//Flag of the innermost CancelScope on this thread, nullptr if none
+const std::atomic<bool>*& currentCancelFlag();
+
+class CancelScope
+{
+public:
+    explicit CancelScope(const std::atomic<bool>& cancelled) :
+        m_pPreviousFlag(currentCancelFlag())
+    {
+        currentCancelFlag() = &cancelled;
+    }
+
+    ~CancelScope()
+    {
+        currentCancelFlag() = m_pPreviousFlag;
+    }
+
+private:
+    const std::atomic<bool>* m_pPreviousFlag;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Concurrent operations
+///
+///Rows are split into bands of ~PixelsPerRowBand pixels which are spread over QThreadPool::globalInstance().
+///  Kernels must only write to the rows they are given.
+
+struct RowBand
+{
+    int firstRow;
+    int endRow;//Exclusive
+};
+
+//Calls bandKernel(int firstRow, int endRow) for bands of rows covering 0 -> height
+//  minRowsPerBand is for kernels with a per band setup cost (ie sliding windows that need priming)
+template<typename BandKernel>
+void operateOnRowBandsConcurrent(const int width, const int height, BandKernel&& bandKernel, const int minRowsPerBand = 1)
+{
+    if(width <= 0 || height <= 0)
+    {
+        return;
+    }
+
+    const int pixelRowsPerBand = width < PixelsPerRowBand ? PixelsPerRowBand / width : 1;
+    const int rowsPerBand = pixelRowsPerBand > minRowsPerBand ? pixelRowsPerBand : minRowsPerBand;
+    if(rowsPerBand >= height)
+    {
+        bandKernel(0, height);
+        return;
+    }
+
+    QVector<RowBand> bands;
+    bands.reserve(height / rowsPerBand + 1);
+    for(int y = 0; y < height; y += rowsPerBand)
+    {
+        bands.push_back({y, y + rowsPerBand < height ? y + rowsPerBand : height});
+    }
+
+    //Bands run on pool threads, so take the flag of the calling thread
+    const std::atomic<bool>* pCancelled = currentCancelFlag();
+    QtConcurrent::blockingMap(bands, [&](const RowBand& band)-> void
+    {
+        if(pCancelled && pCancelled->load(std::memory_order_relaxed))
+        {
+            return;
+        }
+        bandKernel(band.firstRow, band.endRow);
+    });
+}
+
+//Same as operateOnScanlines, but rows are processed concurrently
+template<typename ScanlineKernel>
+void operateOnScanlinesConcurrent(QImage& image, ScanlineKernel&& scanlineKernel)
+{
+    ensureArgb32(image);
+
+    const int width = image.width();
+    const qsizetype bytesPerLine = image.bytesPerLine();
+    uchar* bits = image.bits();//Detach before going across threads
+
+    operateOnRowBandsConcurrent(width, image.height(), [&](const int firstRow, const int endRow)-> void
+    {
+        for(int y = firstRow; y < endRow; y++)
+        {
+            scanlineKernel(reinterpret_cast<QRgb*>(bits + y * bytesPerLine), y, width);
+        }
+    });
+}
+
+//Same as operateOnPixels, but rows are processed concurrently
+template<typename PixelKernel>
+void operateOnPixelsConcurrent(QImage& image, PixelKernel&& pixelKernel)
+{
+    operateOnScanlinesConcurrent(image, [&](QRgb* line, const int, const int width)-> void
+    {
+        for(int x = 0; x < width; x++)
+        {
+            line[x] = pixelKernel(line[x]);
+        }
+    });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Color adjustments - single pixel
+///
+///Scalar reference versions. The scanline versions below must give bit for bit the same results.
+
+inline int limitValidRgb(const int value)
+{
+    return value < MinRgbValue ? MinRgbValue : (value > MaxRgbValue ? MaxRgbValue : value);
+}
+
+inline QRgb greyScaleColor(const QRgb col)
+{
+    const int grey = (qRed(col) + qGreen(col) + qBlue(col))/3;
+    return qRgba(grey, grey, grey, qAlpha(col));
+}
+
+inline QRgb invertColor(const QRgb col)
+{
+    return qRgba(MaxRgbValue - qRed(col), MaxRgbValue - qGreen(col), MaxRgbValue - qBlue(col), qAlpha(col));
+}
+
+inline QRgb changeBrightness(const QRgb col, const int value)
+{
+    return qRgba(limitValidRgb(qRed(col) + value), limitValidRgb(qGreen(col) + value), limitValidRgb(qBlue(col) + value), qAlpha(col));
+}
+
+inline int changeContrastRGOB(const int rgob, const int value) // rgob --> stands for red, green or blue
+{
+    //MiddleRgbValue is middle of MinRgbValue and MaxRgbValue, dulling contrast(<0) moves towards MiddleRgbValue, high contrast(>0) moves away.
+
+    if(rgob > MiddleRgbValue)
+    {
+        if(value > 0)
+        {
+            return rgob + value > MaxRgbValue ? MaxRgbValue : rgob + value;
+        }
+        else if(value < 0)
+        {
+            return rgob + value < MiddleRgbValue ? MiddleRgbValue : rgob + value;
+        }
+    }
+    else if(rgob < MiddleRgbValue)
+    {
+        if(value > 0)
+        {
+            return rgob - value < MinRgbValue ? MinRgbValue : rgob - value;
+        }
+        else if(value < 0)
+        {
+            return rgob - value > MiddleRgbValue ? MiddleRgbValue : rgob - value;
+        }
+    }
+
+    return rgob;
+}
+
+inline QRgb changeContrast(const QRgb col, const int value)
+{
+    return qRgba(changeContrastRGOB(qRed(col), value), changeContrastRGOB(qGreen(col), value), changeContrastRGOB(qBlue(col), value), qAlpha(col));
+}
+
+struct ColorMultipliers
+{
+    float redXred = 1;
+    float redXgreen = 0;
+    float redXblue = 0;
+    float greenXred = 0;
+    float greenXgreen = 1;
+    float greenXblue = 0;
+    float blueXred = 0;
+    float blueXgreen = 0;
+    float blueXblue = 1;
+    float xTransparent = 1;
+};
+
+inline QRgb colorMultipliersPixel(const QRgb col, const ColorMultipliers& m)
+{
+    const int red = qRed(col);
+    const int green = qGreen(col);
+    const int blue = qBlue(col);
+    const int newR = int(red * m.redXred + green * m.redXgreen + blue * m.redXblue);
+    const int newG = int(red * m.greenXred + green * m.greenXgreen + blue * m.greenXblue);
+    const int newB = int(red * m.blueXred + green * m.blueXgreen + blue * m.blueXblue);
+    const int newA = int(qAlpha(col) * m.xTransparent);
+    return qRgba(newR > MaxRgbValue ? MaxRgbValue : newR,
+                 newG > MaxRgbValue ? MaxRgbValue : newG,
+                 newB > MaxRgbValue ? MaxRgbValue : newB,
+                 newA);
+}
+
+inline int limitRange(const int value, const int min, const int max)
+{
+    return value < min ? min : (value > max ? max : value);
+}
+
+//Same as qt_div_257 - 16 bit color channel to 8 bit, like QColor does
+inline int div257(const int value)
+{
+    return (value - (value >> 8) + 0x80) >> 8;
+}
+
+//Integer version of QColor::getHsv -> clamp -> QColor::fromHsv. QColor works in 16 bit channels with doubles, the
+//  same roundings are done here exactly on integers, so results are within 1 of QColors (almost always equal).
+//  Hue is clamped rather than wrapped (and hues past MaxHue end up at MaxHue).
+inline QRgb hueAndSaturationPixel(const QRgb originalColor, const int hue, const int saturation)
+{
+    if(qAlpha(originalColor) == 0)
+    {
+        return originalColor;
+    }
+
+    const int red = qRed(originalColor);
+    const int green = qGreen(originalColor);
+    const int blue = qBlue(originalColor);
+    const int maxChannel = red > green ? (red > blue ? red : blue) : (green > blue ? green : blue);
+    const int minChannel = red < green ? (red < blue ? red : blue) : (green < blue ? green : blue);
+    const int delta = maxChannel - minChannel;
+
+    //QColor::getHsv - hue in 1/100ths of a degree is rounded, then truncated to whole degrees. Grey has hue -1.
+    int h = -1;
+    int s = 0;
+    if(delta != 0)
+    {
+        s = div257((2 * 65535 * delta + maxChannel) / (2 * maxChannel));
+
+        //Hue in 1/100ths of a degree, multiplied by delta
+        int hueNumerator;
+        if(red == maxChannel)
+        {
+            hueNumerator = 6000 * (green - blue) + (green < blue ? 36000 * delta : 0);
+        }
+        else if(green == maxChannel)
+        {
+            hueNumerator = 12000 * delta + 6000 * (blue - red);
+        }
+        else
+        {
+            hueNumerator = 24000 * delta + 6000 * (red - green);
+        }
+        h = ((2 * hueNumerator + delta) / (2 * delta)) / 100;
+    }
+
+    const int newHue = limitRange(h + hue, MinHue, MaxHue);
+    const int newSaturation = limitRange(s + saturation, MinSaturation, MaxSaturation);
+    const int value = maxChannel;
+    if(newSaturation == 0)
+    {
+        return qRgba(value, value, value, qAlpha(originalColor));
+    }
+
+    //QColor::fromHsv - 16 bit channels rounded, then back to 8 bit. 15300 is 255 (saturation) * 60 (degrees per sector).
+    const int sector = newHue / 60;
+    const int sectorDegrees = newHue - sector * 60;
+    const int value16 = value * 257;
+    const int p = div257((2 * value16 * (MaxRgbValue - newSaturation) + MaxRgbValue) / (2 * MaxRgbValue));
+    const int q = div257((2 * value16 * (15300 - newSaturation * sectorDegrees) + 15300) / (2 * 15300));
+    const int t = div257((2 * value16 * (15300 - newSaturation * (60 - sectorDegrees)) + 15300) / (2 * 15300));
+    switch (sector)
+    {
+        case 0:
+            return qRgba(value, t, p, qAlpha(originalColor));
+        case 1:
+            return qRgba(q, value, p, qAlpha(originalColor));
+        case 2:
+            return qRgba(p, value, t, qAlpha(originalColor));
+        case 3:
+            return qRgba(p, q, value, qAlpha(originalColor));
+        case 4:
+            return qRgba(t, p, value, qAlpha(originalColor));
+        default:
+            return qRgba(value, p, q, qAlpha(originalColor));
+    }
+}
+
+inline bool isIdentity(const ColorMultipliers& m)
+{
+    return m.redXred == 1 && m.redXgreen == 0 && m.redXblue == 0 &&
+           m.greenXred == 0 && m.greenXgreen == 1 && m.greenXblue == 0 &&
+           m.blueXred == 0 && m.blueXgreen == 0 && m.blueXblue == 1 &&
+           m.xTransparent == 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Channel lookup tables
+///
+///Adjustments where each of red, green and blue only depends on its own old value (brightness, contrast, levels)
+///  are a 256 entry table, built once per setting instead of worked out with branches for every channel.
+///  Tables compose, so a stack of them still costs one lookup per channel.
+struct ChannelLut
+{
+    uchar values[MaxRgbValue + 1];
+};
+
+struct Levels
+{
+    int inputBlack = MinRgbValue;//Input values at or below become outputBlack
+    int inputWhite = MaxRgbValue;//Input values at or above become outputWhite
+    float gamma = 1;//>1 brightens the mid tones, <1 darkens them
+    int outputBlack = MinRgbValue;
+    int outputWhite = MaxRgbValue;
+
+    bool isIdentity() const
+    {
+        return inputBlack == MinRgbValue && inputWhite == MaxRgbValue && gamma == 1 && outputBlack == MinRgbValue && outputWhite == MaxRgbValue;
+    }
+};
+
+ChannelLut identityLut();
+ChannelLut brightnessLut(const int value);//Same as changeBrightness
+ChannelLut contrastLut(const int value);//Same as changeContrastRGOB
+ChannelLut levelsLut(const Levels& levels);
+
+//Table of second applied after first
+ChannelLut composedLut(const ChannelLut& first, const ChannelLut& second);
+
+inline QRgb lutPixel(const QRgb col, const ChannelLut& lut)
+{
+    return qRgba(lut.values[qRed(col)], lut.values[qGreen(col)], lut.values[qBlue(col)], qAlpha(col));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Color adjustments - fused
+///
+///Stack of the point adjustments (each pixel only depends on itself), applied in one pass over the image instead of
+///  one pass per adjustment. Applied in member order, adjustments left at their defaults are skipped.
+struct Adjustments
+{
+    int brightness = 0;
+    int contrast = 0;
+    Levels levels;
+    ColorMultipliers multipliers;
+    bool hueSaturation = false;//Once set hue/saturation runs even at 0/0 - which isnt a no-op, hues past MaxHue are clamped
+    int hue = 0;
+    int saturation = 0;
+
+    bool isIdentity() const
+    {
+        return brightness == 0 && contrast == 0 && levels.isIdentity() &&
+               PixelKernels::isIdentity(multipliers) && !hueSaturation && hue == 0 && saturation == 0;
+    }
+};
+
+//Adjustments with everything that only depends on the settings (ie the channel table) worked out, once per pass
+struct PreparedAdjustments
+{
+    bool hasChannelLut = false;
+    ChannelLut channelLut;//brightness, contrast and levels composed
+
+    //Set when brightness and contrast are the only per channel adjustments - for scanlines their SIMD kernels (even
+    //  both, one after the other) beat a table lookup. Single pixels always use the table.
+    int simdBrightness = 0;
+    int simdContrast = 0;
+
+    bool multiply = false;
+    ColorMultipliers multipliers;
+
+    bool hueSaturation = false;
+    int hue = 0;
+    int saturation = 0;
+};
+
+PreparedAdjustments prepareAdjustments(const Adjustments& adjustments);
+
+inline QRgb adjustPixel(QRgb col, const PreparedAdjustments& adjustments)
+{
+    if(adjustments.hasChannelLut)
+    {
+        col = lutPixel(col, adjustments.channelLut);
+    }
+    if(adjustments.multiply)
+    {
+        col = colorMultipliersPixel(col, adjustments.multipliers);
+    }
+    if(adjustments.hueSaturation)
+    {
+        col = hueAndSaturationPixel(col, adjustments.hue, adjustments.saturation);
+    }
+    return col;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Color adjustments - scanlines
+///
+///SIMD versions (AVX2 or SSE2, picked at runtime from CPUID) with a scalar fallback for other cpus and line tails.
+void greyScale(QRgb* line, const int width);
+void invert(QRgb* line, const int width);
+void changeBrightness(QRgb* line, const int width, const int value);
+void changeContrast(QRgb* line, const int width, const int value);
+void colorMultipliers(QRgb* line, const int width, const ColorMultipliers& multipliers);
+void hueAndSaturation(QRgb* line, const int width, const int hue, const int saturation);
+
+//Scalar, unrolled by 4. A SIMD gather from a byte table is no faster than 3 independent scalar loads per pixel.
+void applyLut(QRgb* line, const int width, const ChannelLut& lut);
+
+//Same result as adjustPixel on every pixel. Each adjustment is run over chunks of the line small enough to stay in
+//  L1 cache, so the line is only read from/written to memory once.
+void adjust(QRgb* line, const int width, const PreparedAdjustments& adjustments);
+
+enum class SimdLevel
+{
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+//Best instruction set supported by this cpu
+SimdLevel detectedSimdLevel();
+
+//Instruction set in use by the scanline kernels. Can be lowered (ie to compare results against the scalar versions)
+SimdLevel simdLevel();
+void setSimdLevel(const SimdLevel level);
+
+}
+
+#endif // PIXELKERNELS_H
@@ -0,0 +1,367 @@
+#include "selectionmask.h"
+
+#include <algorithm>
+
+SelectionMask::SelectionMask()
+{
+}
+
+SelectionMask SelectionMask::fromRect(const QRect& rect)
+{
+    SelectionMask mask;
+    if(!rect.isValid())
+    {
+        return mask;
+    }
+
+    for(int y = rect.top(); y <= rect.bottom(); y++)
+    {
+        mask.appendSpan(y, rect.left(), rect.right());
+    }
+    mask.updateBounds();
+    return mask;
+}
+
+SelectionMask SelectionMask::fromBits(const QBitArray& bits, const int& width, const int& height)
+{
+    SelectionMask mask;
+    for(int y = 0; y < height; y++)
+    {
+        int x = 0;
+        while(x < width)
+        {
+            if(!bits.testBit(y * width + x))
+            {
+                x++;
+                continue;
+            }
+
+            const int left = x;
+            while(x + 1 < width && bits.testBit(y * width + x + 1))
+            {
+                x++;
+            }
+            mask.appendSpan(y, left, x);
+            x++;
+        }
+    }
+    mask.updateBounds();
+    return mask;
+}
+
+SelectionMask SelectionMask::fromImageAlpha(const QImage& image)
+{
+    const QImage argbImage = image.format() == QImage::Format_ARGB32 ? image : image.convertToFormat(QImage::Format_ARGB32);
+
+    SelectionMask mask;
+    for(int y = 0; y < argbImage.height(); y++)
+    {
+        const QRgb* line = reinterpret_cast<const QRgb*>(argbImage.constScanLine(y));
+        int x = 0;
+        while(x < argbImage.width())
+        {
+            if(qAlpha(line[x]) == 0)
+            {
+                x++;
+                continue;
+            }
+
+            const int left = x;
+            while(x + 1 < argbImage.width() && qAlpha(line[x + 1]) > 0)
+            {
+                x++;
+            }
+            mask.appendSpan(y, left, x);
+            x++;
+        }
+    }
+    mask.updateBounds();
+    return mask;
+}
+
+bool SelectionMask::isEmpty() const
+{
+    return m_pixelCount == 0;
+}
+
+qint64 SelectionMask::pixelCount() const
+{
+    return m_pixelCount;
+}
+
+QRect SelectionMask::boundingRect() const
+{
+    return m_boundingRect;
+}
+
+bool SelectionMask::contains(const int& x, const int& y) const
+{
+    const int row = y - m_top;
+    if(row < 0 || row >= rowCount())
+    {
+        return false;
+    }
+
+    //Find last span starting at or before x
+    const Span* rowBegin = m_spans.constData() + m_rowStarts[row];
+    const Span* rowEnd = m_spans.constData() + m_rowStarts[row + 1];
+    const int localX = x - m_offsetX;
+    const Span* after = std::upper_bound(rowBegin, rowEnd, localX, [](const int value, const Span& span)-> bool
+    {
+        return value < span.left;
+    });
+
+    return after != rowBegin && (after - 1)->right >= localX;
+}
+
+QPainterPath SelectionMask::outlinePath() const
+{
+    QPainterPath path;
+
+    //Horizontal lines - line y (top of row y) has a border wherever only one of rows y - 1 & y is selected.
+    //  Walking the edges of both rows in x order, that flips at every x where exactly one row has an edge.
+    for(int row = 0; row <= rowCount(); row++)
+    {
+        const int y = m_top + row;
+        const int aboveCount = rowEdgeCount(row - 1);
+        const int belowCount = rowEdgeCount(row);
+        int above = 0;
+        int below = 0;
+        bool inBorder = false;
+        int borderLeft = 0;
+        while(above < aboveCount || below < belowCount)
+        {
+            const bool takeAbove = above < aboveCount && (below >= belowCount || rowEdge(row - 1, above) <= rowEdge(row, below));
+            const int x = takeAbove ? rowEdge(row - 1, above) : rowEdge(row, below);
+
+            int edgesAtX = 0;
+            if(above < aboveCount && rowEdge(row - 1, above) == x)
+            {
+                above++;
+                edgesAtX++;
+            }
+            if(below < belowCount && rowEdge(row, below) == x)
+            {
+                below++;
+                edgesAtX++;
+            }
+
+            if(edgesAtX == 1)
+            {
+                if(inBorder)
+                {
+                    path.moveTo(borderLeft, y);
+                    path.lineTo(x, y);
+                }
+                borderLeft = x;
+                inBorder = !inBorder;
+            }
+        }
+    }
+
+    //Vertical lines - every span edge is a border of its row, joined onto the same edge of the row above.
+    //  Open lines are kept sorted by x, so each row is one merge with them.
+    struct VerticalBorder
+    {
+        int x;
+        int top;
+    };
+    QVector<VerticalBorder> openBorders;
+    QVector<VerticalBorder> continuedBorders;
+    for(int row = 0; row <= rowCount(); row++)
+    {
+        const int y = m_top + row;
+        const int edgeCount = rowEdgeCount(row);
+        int open = 0;
+        int edge = 0;
+        continuedBorders.clear();
+        while(open < openBorders.size() || edge < edgeCount)
+        {
+            if(edge >= edgeCount || (open < openBorders.size() && openBorders[open].x < rowEdge(row, edge)))
+            {
+                //Border ended on the row above
+                path.moveTo(openBorders[open].x, openBorders[open].top);
+                path.lineTo(openBorders[open].x, y);
+                open++;
+            }
+            else if(open < openBorders.size() && openBorders[open].x == rowEdge(row, edge))
+            {
+                continuedBorders.push_back(openBorders[open]);
+                open++;
+                edge++;
+            }
+            else
+            {
+                continuedBorders.push_back({rowEdge(row, edge), y});
+                edge++;
+            }
+        }
+        openBorders.swap(continuedBorders);
+    }
+
+    return path;
+}
+
+SelectionMask SelectionMask::united(const SelectionMask& other) const
+{
+    if(other.isEmpty())
+    {
+        return *this;
+    }
+    if(isEmpty())
+    {
+        return other;
+    }
+
+    SelectionMask mask;
+    const int top = std::min(m_top, other.m_top);
+    const int end = std::max(m_top + rowCount(), other.m_top + other.rowCount());
+    for(int y = top; y < end; y++)
+    {
+        const int row = y - m_top;
+        const int otherRow = y - other.m_top;
+        int i = row >= 0 && row < rowCount() ? m_rowStarts[row] : 0;
+        const int iEnd = row >= 0 && row < rowCount() ? m_rowStarts[row + 1] : 0;
+        int j = otherRow >= 0 && otherRow < other.rowCount() ? other.m_rowStarts[otherRow] : 0;
+        const int jEnd = otherRow >= 0 && otherRow < other.rowCount() ? other.m_rowStarts[otherRow + 1] : 0;
+
+        //Merge both rows by left edge, appendSpan joins any overlaps
+        while(i < iEnd || j < jEnd)
+        {
+            const bool takeThis = j >= jEnd || (i < iEnd && m_spans[i].left + m_offsetX <= other.m_spans[j].left + other.m_offsetX);
+            if(takeThis)
+            {
+                mask.appendSpan(y, m_spans[i].left + m_offsetX, m_spans[i].right + m_offsetX);
+                i++;
+            }
+            else
+            {
+                mask.appendSpan(y, other.m_spans[j].left + other.m_offsetX, other.m_spans[j].right + other.m_offsetX);
+                j++;
+            }
+        }
+    }
+    mask.updateBounds();
+    return mask;
+}
+
+SelectionMask SelectionMask::intersected(const SelectionMask& other) const
+{
+    SelectionMask mask;
+    const int top = std::max(m_top, other.m_top);
+    const int end = std::min(m_top + rowCount(), other.m_top + other.rowCount());
+    for(int y = top; y < end; y++)
+    {
+        int i = m_rowStarts[y - m_top];
+        const int iEnd = m_rowStarts[y - m_top + 1];
+        int j = other.m_rowStarts[y - other.m_top];
+        const int jEnd = other.m_rowStarts[y - other.m_top + 1];
+
+        while(i < iEnd && j < jEnd)
+        {
+            const int thisLeft = m_spans[i].left + m_offsetX;
+            const int thisRight = m_spans[i].right + m_offsetX;
+            const int otherLeft = other.m_spans[j].left + other.m_offsetX;
+            const int otherRight = other.m_spans[j].right + other.m_offsetX;
+
+            const int left = std::max(thisLeft, otherLeft);
+            const int right = std::min(thisRight, otherRight);
+            if(left <= right)
+            {
+                mask.appendSpan(y, left, right);
+            }
+
+            //Move on whichever span finishes first
+            if(thisRight < otherRight)
+            {
+                i++;
+            }
+            else
+            {
+                j++;
+            }
+        }
+    }
+    mask.updateBounds();
+    return mask;
+}
+
+SelectionMask SelectionMask::translated(const int& dx, const int& dy) const
+{
+    SelectionMask mask = *this;
+    mask.m_top += dy;
+    mask.m_offsetX += dx;
+    if(m_pixelCount > 0)
+    {
+        //Empty masks keep a null rect (QRect() translated isnt null)
+        mask.m_boundingRect.translate(dx, dy);
+    }
+    return mask;
+}
+
+void SelectionMask::clear()
+{
+    m_spans.clear();
+    m_rowStarts.clear();
+    m_top = 0;
+    m_offsetX = 0;
+    m_pixelCount = 0;
+    m_boundingRect = QRect();
+}
+
+void SelectionMask::appendSpan(const int& y, const int& left, const int& right)
+{
+    if(m_rowStarts.isEmpty())
+    {
+        m_top = y;
+        m_rowStarts.push_back(0);
+    }
+
+    //Add (empty) rows up to y
+    while(m_top + rowCount() <= y)
+    {
+        m_rowStarts.push_back(m_spans.size());
+    }
+
+    const int localLeft = left - m_offsetX;
+    const int localRight = right - m_offsetX;
+    const bool rowHasSpans = m_rowStarts[rowCount() - 1] < m_spans.size();
+    if(rowHasSpans && m_spans.last().right + 1 >= localLeft)
+    {
+        m_spans.last().right = std::max(m_spans.last().right, localRight);
+    }
+    else
+    {
+        m_spans.push_back({localLeft, localRight});
+    }
+    m_rowStarts.last() = m_spans.size();
+}
+
+void SelectionMask::updateBounds()
+{
+    m_pixelCount = 0;
+    m_boundingRect = QRect();
+
+    int left = 0;
+    int right = 0;
+    int top = 0;
+    int bottom = 0;
+    forEachSpan([&](const int y, const int spanLeft, const int spanRight)-> void
+    {
+        if(m_pixelCount == 0)
+        {
+            left = spanLeft;
+            right = spanRight;
+            top = y;
+        }
+        left = std::min(left, spanLeft);
+        right = std::max(right, spanRight);
+        bottom = y;
+        m_pixelCount += spanRight - spanLeft + 1;
+    });
+
+    if(m_pixelCount > 0)
+    {
+        m_boundingRect = QRect(QPoint(left, top), QPoint(right, bottom));
+    }
+}
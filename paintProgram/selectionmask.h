@@ -0,0 +1,128 @@
+#ifndef SELECTIONMASK_H
+#define SELECTIONMASK_H
+
+#include <QVector>
+#include <QRect>
+#include <QImage>
+#include <QBitArray>
+#include <QPainterPath>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// SelectionMask
+///
+///Set of selected pixels stored as run length spans per row (rather than a point per pixel).
+///  Spans are kept sorted, non overlapping and non touching within each row, so a full canvas selection is one span per row.
+///  Copies are cheap (implicitly shared QVectors) and translating only moves the origin.
+class SelectionMask
+{
+public:
+    //Selected pixels left -> right (inclusive) on a row
+    struct Span
+    {
+        int left;
+        int right;
+    };
+
+    SelectionMask();
+
+    ///Construction
+    static SelectionMask fromRect(const QRect& rect);
+    static SelectionMask fromBits(const QBitArray& bits, const int& width, const int& height);//Row major width * height
+    static SelectionMask fromImageAlpha(const QImage& image);//Pixels with alpha > 0
+
+    ///Info
+    bool isEmpty() const;
+    qint64 pixelCount() const;
+    QRect boundingRect() const;
+    bool contains(const int& x, const int& y) const;
+
+    ///Outline
+    //Border between selected & unselected pixels (on pixel corners), as maximal horizontal & vertical lines.
+    //  Linear in the number of spans.
+    QPainterPath outlinePath() const;
+
+    ///Operations
+    SelectionMask united(const SelectionMask& other) const;
+    SelectionMask intersected(const SelectionMask& other) const;
+    SelectionMask translated(const int& dx, const int& dy) const;
+    void clear();
+
+    ///Iteration
+    //Calls func(int y, int left, int right) for every span, top to bottom, left to right
+    template<typename Func>
+    void forEachSpan(Func&& func) const
+    {
+        for(int row = 0; row < rowCount(); row++)
+        {
+            for(int i = m_rowStarts[row]; i < m_rowStarts[row + 1]; i++)
+            {
+                func(m_top + row, m_spans[i].left + m_offsetX, m_spans[i].right + m_offsetX);
+            }
+        }
+    }
+
+    //Same as forEachSpan, but spans are clipped to rect (ie an images rect)
+    template<typename Func>
+    void forEachSpanInRect(const QRect& rect, Func&& func) const
+    {
+        const int firstRow = rect.top() > m_top ? rect.top() - m_top : 0;
+        const int endRow = rect.bottom() - m_top + 1 < rowCount() ? rect.bottom() - m_top + 1 : rowCount();
+        for(int row = firstRow; row < endRow; row++)
+        {
+            for(int i = m_rowStarts[row]; i < m_rowStarts[row + 1]; i++)
+            {
+                const int left = m_spans[i].left + m_offsetX > rect.left() ? m_spans[i].left + m_offsetX : rect.left();
+                const int right = m_spans[i].right + m_offsetX < rect.right() ? m_spans[i].right + m_offsetX : rect.right();
+                if(left <= right)
+                {
+                    func(m_top + row, left, right);
+                }
+            }
+        }
+    }
+
+    //Calls func(int x, int y) for every selected pixel
+    template<typename Func>
+    void forEachPixel(Func&& func) const
+    {
+        forEachSpan([&](const int y, const int left, const int right)-> void
+        {
+            for(int x = left; x <= right; x++)
+            {
+                func(x, y);
+            }
+        });
+    }
+
+private:
+    //Building - spans must be appended top to bottom, left to right. Touching/overlapping spans are merged.
+    void appendSpan(const int& y, const int& left, const int& right);
+    void updateBounds();
+
+    int rowCount() const
+    {
+        return m_rowStarts.isEmpty() ? 0 : m_rowStarts.size() - 1;
+    }
+
+    //Span edges of row as a sorted list: left, right + 1, left, right + 1... (0 edges outside the rows)
+    int rowEdgeCount(const int& row) const
+    {
+        return row < 0 || row >= rowCount() ? 0 : (m_rowStarts[row + 1] - m_rowStarts[row]) * 2;
+    }
+    int rowEdge(const int& row, const int& i) const
+    {
+        const Span& span = m_spans[m_rowStarts[row] + i / 2];
+        return (i % 2 == 0 ? span.left : span.right + 1) + m_offsetX;
+    }
+
+    //m_spans[m_rowStarts[row] -> m_rowStarts[row + 1]] are the spans of row (m_top + row)
+    QVector<Span> m_spans;
+    QVector<int> m_rowStarts;
+    int m_top = 0;
+    int m_offsetX = 0;//Added to the x of every span
+
+    qint64 m_pixelCount = 0;
+    QRect m_boundingRect = QRect();
+};
+
+#endif // SELECTIONMASK_H
@@ -0,0 +1,290 @@
+#include <QtTest>
+#include <QImage>
+#include <QBuffer>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <algorithm>
+
+#include "canvasfile.h"
+
+namespace Constants
+{
+//4K document
+const int BenchWidth = 3840;
+const int BenchHeight = 2160;
+const int LayerCounts[] = {1, 4, 8};
+
+//Each layer is mostly transparent with a few flat and gradient shapes, plus a noisy patch standing in for a photo
+const int ShapesPerLayer = 6;
+const int NoiseSize = 512;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// BenchCanvasFile
+///
+///Saving & loading multi layer documents, timed with QBENCHMARK. The "Text" benchmarks use the version 1 format (hex
+///  encoded PNG per layer), written the way Canvas::save used to and read back by CanvasFile's version 1 reader.
+///  File sizes are logged alongside the save timings.
+class BenchCanvasFile : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void saveText_data();
+    void saveText();
+    void saveBinary_data();
+    void saveBinary();
+    void saveBinaryHistoryTiles_data();
+    void saveBinaryHistoryTiles();
+
+    void loadText_data();
+    void loadText();
+    void loadBinary_data();
+    void loadBinary();
+    void loadBinaryDecoded_data();
+    void loadBinaryDecoded();
+
+private:
+    QTemporaryDir m_dir;
+    QList<CanvasLayer> m_layers;//Constants::LayerCounts max layers, benchmarks use the first few
+
+    QList<CanvasLayer> layers(const int& count) const;
+    QString filePath(const QString& format, const int& count) const;
+    void layerCountData();
+};
+
+namespace
+{
+
+QImage genLayer(quint32 seed)
+{
+    auto random = [&](const int& max)-> int
+    {
+        seed = seed * 1664525 + 1013904223;
+        return int((seed >> 8) % quint32(max));
+    };
+
+    QImage image = QImage(Constants::BenchWidth, Constants::BenchHeight, QImage::Format_ARGB32);
+    image.fill(Qt::transparent);
+
+    for(int shape = 0; shape < Constants::ShapesPerLayer; shape++)
+    {
+        const QRect rect = QRect(random(image.width()), random(image.height()), random(image.width() / 2) + 1, random(image.height() / 2) + 1) & image.rect();
+        const QRgb color = qRgba(random(256), random(256), random(256), 255);
+        const bool gradient = shape % 2 == 0;
+        for(int y = rect.top(); y <= rect.bottom(); y++)
+        {
+            QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+            for(int x = rect.left(); x <= rect.right(); x++)
+            {
+                line[x] = gradient ? qRgba(qRed(color), (x - rect.left()) % 256, (y - rect.top()) % 256, 255) : color;
+            }
+        }
+    }
+
+    const QRect noiseRect = QRect(random(image.width() - Constants::NoiseSize), random(image.height() - Constants::NoiseSize), Constants::NoiseSize, Constants::NoiseSize);
+    for(int y = noiseRect.top(); y <= noiseRect.bottom(); y++)
+    {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for(int x = noiseRect.left(); x <= noiseRect.right(); x++)
+        {
+            line[x] = qRgba(random(256), random(256), random(256), 255);
+        }
+    }
+    return image;
+}
+
+//How Canvas::save wrote files before the binary format
+bool saveText(const QString& path, const QList<CanvasLayer>& layers)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        return false;
+    }
+    QTextStream out(&file);
+
+    for(const CanvasLayer& cl : layers)
+    {
+        out << "BEGIN_LAYER" << "\n";
+        out << cl.m_info.m_name << "\n";
+        out << cl.m_info.m_enabled << "\n";
+
+        QByteArray ba;
+        QBuffer buffer(&ba);
+        buffer.open(QIODevice::WriteOnly);
+
+        cl.m_image.save(&buffer, "PNG");
+        out << buffer.data().toHex() << "\n";
+        out << "END_LAYER" << "\n";
+    }
+    return true;
+}
+
+}
+
+void BenchCanvasFile::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+
+    const int maxLayers = *std::max_element(std::begin(Constants::LayerCounts), std::end(Constants::LayerCounts));
+    for(int i = 0; i < maxLayers; i++)
+    {
+        CanvasLayer layer;
+        layer.m_info.m_name = QString("Layer %1").arg(i);
+        layer.m_image = genLayer(quint32(i + 1));
+        m_layers.push_back(layer);
+    }
+
+    //Files for the load benchmarks
+    for(const int count : Constants::LayerCounts)
+    {
+        QVERIFY(::saveText(filePath("text", count), layers(count)));
+        QVERIFY(CanvasFile::save(filePath("binary", count), layers(count)));
+    }
+}
+
+void BenchCanvasFile::saveText_data()
+{
+    layerCountData();
+}
+
+void BenchCanvasFile::saveText()
+{
+    QFETCH(int, layerCount);
+    const QList<CanvasLayer> saveLayers = layers(layerCount);
+    const QString path = m_dir.filePath("saveText");
+    QBENCHMARK
+    {
+        QVERIFY(::saveText(path, saveLayers));
+    }
+    qDebug() << layerCount << "layers:" << QFileInfo(path).size() / 1024 << "KB";
+}
+
+void BenchCanvasFile::saveBinary_data()
+{
+    layerCountData();
+}
+
+void BenchCanvasFile::saveBinary()
+{
+    QFETCH(int, layerCount);
+    const QList<CanvasLayer> saveLayers = layers(layerCount);
+    const QString path = m_dir.filePath("saveBinary");
+    QBENCHMARK
+    {
+        QVERIFY(CanvasFile::save(path, saveLayers));
+    }
+    qDebug() << layerCount << "layers:" << QFileInfo(path).size() / 1024 << "KB";
+}
+
+void BenchCanvasFile::saveBinaryHistoryTiles_data()
+{
+    layerCountData();
+}
+
+//As Canvas saves - with the tiles recorded for history passed in, so only recompressing them for the file is timed
+void BenchCanvasFile::saveBinaryHistoryTiles()
+{
+    QFETCH(int, layerCount);
+    const QList<CanvasLayer> saveLayers = layers(layerCount);
+    QList<TiledImage> historyTiles;
+    for(const CanvasLayer& layer : saveLayers)
+    {
+        historyTiles.push_back(TiledImage::fromImage(layer.m_image));
+    }
+
+    const QString path = m_dir.filePath("saveBinaryHistoryTiles");
+    QBENCHMARK
+    {
+        QVERIFY(CanvasFile::save(path, saveLayers, historyTiles));
+    }
+    qDebug() << layerCount << "layers:" << QFileInfo(path).size() / 1024 << "KB";
+
+    QList<CanvasLayer> loadedLayers;
+    QVERIFY(CanvasFile::load(path, loadedLayers));
+    QCOMPARE(loadedLayers.last().m_undecodedImage.toImage(), saveLayers.last().m_image);
+}
+
+void BenchCanvasFile::loadText_data()
+{
+    layerCountData();
+}
+
+void BenchCanvasFile::loadText()
+{
+    QFETCH(int, layerCount);
+    QList<CanvasLayer> loadedLayers;
+    QBENCHMARK
+    {
+        QVERIFY(CanvasFile::load(filePath("text", layerCount), loadedLayers));
+    }
+    QCOMPARE(loadedLayers.size(), layerCount);
+}
+
+void BenchCanvasFile::loadBinary_data()
+{
+    layerCountData();
+}
+
+//As CanvasFile::load returns them - tiles still compressed
+void BenchCanvasFile::loadBinary()
+{
+    QFETCH(int, layerCount);
+    QList<CanvasLayer> loadedLayers;
+    QBENCHMARK
+    {
+        QVERIFY(CanvasFile::load(filePath("binary", layerCount), loadedLayers));
+    }
+    QCOMPARE(loadedLayers.size(), layerCount);
+}
+
+void BenchCanvasFile::loadBinaryDecoded_data()
+{
+    layerCountData();
+}
+
+//Load plus decoding every layer, comparable with loadText
+void BenchCanvasFile::loadBinaryDecoded()
+{
+    QFETCH(int, layerCount);
+    QList<CanvasLayer> loadedLayers;
+    QBENCHMARK
+    {
+        QVERIFY(CanvasFile::load(filePath("binary", layerCount), loadedLayers));
+        for(CanvasLayer& layer : loadedLayers)
+        {
+            layer.m_image = layer.m_undecodedImage.toImage();
+            layer.m_undecodedImage = TiledImage();
+        }
+    }
+    QCOMPARE(loadedLayers.size(), layerCount);
+    QCOMPARE(loadedLayers.last().m_image, m_layers[layerCount - 1].m_image);
+}
+
+QList<CanvasLayer> BenchCanvasFile::layers(const int& count) const
+{
+    return m_layers.mid(0, count);
+}
+
+QString BenchCanvasFile::filePath(const QString& format, const int& count) const
+{
+    return m_dir.filePath(QString("%1_%2.paintProgram").arg(format).arg(count));
+}
+
+void BenchCanvasFile::layerCountData()
+{
+    QTest::addColumn<int>("layerCount");
+    for(const int count : Constants::LayerCounts)
+    {
+        QTest::newRow(qPrintable(QString("%1 layers").arg(count))) << count;
+    }
+}
+
+QTEST_GUILESS_MAIN(BenchCanvasFile)
+
+#include "bench_canvasfile.moc"
@@ -0,0 +1,19 @@
+QT       += core gui concurrent testlib
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+TARGET = bench_canvasfile
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    bench_canvasfile.cpp \
+    ../../canvasfile.cpp \
+    ../../tiledimage.cpp
+
+HEADERS += \
+    ../../canvasfile.h \
+    ../../canvaslayer.h \
+    ../../tiledimage.h
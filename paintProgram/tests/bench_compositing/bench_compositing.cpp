@@ -0,0 +1,164 @@
+#include <QtTest>
+#include <QImage>
+#include <QPainter>
+#include <QBrush>
+#include <algorithm>
+
+#include "layercompositor.h"
+
+namespace Constants
+{
+//4K canvas shown at 100% in a 1080p window, so a frame repaints a 1920x1080 part of it
+const int CanvasWidth = 3840;
+const int CanvasHeight = 2160;
+const QRect ExposedRect = QRect(0, 0, 1920, 1080);
+const int LayerCounts[] = {1, 2, 4, 8, 16, 32};
+const float ZoomFactor = 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// BenchCompositing
+///
+///Cost of drawing the layers for one Canvas::paintEvent frame against the number of enabled layers, timed with
+///  QBENCHMARK. The selected layer is in the middle of the stack. Goes through the same LayerCompositor as Canvas.
+///  allLayers         - how frames were drawn before the layer composites: background, then every enabled layer
+///  composites        - with the below/above composites up to date: three blits however many layers there are
+///  rebuildComposites - what a frame costs when another layer has changed & the composites are rebuilt first
+class BenchCompositing : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void allLayers_data();
+    void allLayers();
+    void composites_data();
+    void composites();
+    void rebuildComposites_data();
+    void rebuildComposites();
+
+private:
+    QList<CanvasLayer> m_layers;//Constants::LayerCounts max layers, benchmarks use the first few
+
+    void layerCountData();
+};
+
+namespace
+{
+
+//Half transparent, half opaque, so drawing it has to blend
+QImage genLayer(const int& index)
+{
+    QImage image = QImage(QSize(Constants::CanvasWidth, Constants::CanvasHeight), QImage::Format_ARGB32);
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+    painter.fillRect(QRect(0, 0, Constants::CanvasWidth / 2, Constants::CanvasHeight), QColor((index * 40) % 256, 100, 200, 128 + index % 128));
+    return image;
+}
+
+//Stand in for the widget being painted
+QImage genFrame()
+{
+    QImage frame = QImage(Constants::ExposedRect.size(), QImage::Format_ARGB32_Premultiplied);
+    frame.fill(Qt::white);
+    return frame;
+}
+
+//As Canvas::paintEvent draws the layers
+void drawFrame(QImage& frame, LayerCompositor& compositor, const QList<CanvasLayer>& layers, const int& selectedLayer)
+{
+    const QSize canvasSize = QSize(Constants::CanvasWidth, Constants::CanvasHeight);
+    MipPyramid selectedLayerMips;
+
+    QPainter painter(&frame);
+    compositor.update(layers, selectedLayer, canvasSize);
+    compositor.drawBelowSelectedLayer(painter, Constants::ExposedRect, Constants::ZoomFactor, QPoint(0, 0));
+    LayerCompositor::drawCanvasImage(painter, layers[selectedLayer].m_image, selectedLayerMips, Constants::ExposedRect, Constants::ZoomFactor, QPoint(0, 0));
+    compositor.drawAboveSelectedLayer(painter, Constants::ExposedRect, Constants::ZoomFactor, QPoint(0, 0));
+}
+
+}
+
+void BenchCompositing::initTestCase()
+{
+    const int maxLayers = *std::max_element(std::begin(Constants::LayerCounts), std::end(Constants::LayerCounts));
+    for(int i = 0; i < maxLayers; i++)
+    {
+        CanvasLayer layer;
+        layer.m_image = genLayer(i);
+        m_layers.push_back(layer);
+    }
+}
+
+void BenchCompositing::allLayers_data()
+{
+    layerCountData();
+}
+
+void BenchCompositing::allLayers()
+{
+    QFETCH(int, layerCount);
+    const QList<CanvasLayer> layers = m_layers.mid(0, layerCount);
+    QImage frame = genFrame();
+    QBENCHMARK
+    {
+        QPainter painter(&frame);
+        painter.fillRect(frame.rect(), LayerCompositor::transparentPixelsBrush());
+        for(const CanvasLayer& layer : layers)
+        {
+            painter.drawImage(frame.rect(), layer.m_image, Constants::ExposedRect);
+        }
+    }
+}
+
+void BenchCompositing::composites_data()
+{
+    layerCountData();
+}
+
+void BenchCompositing::composites()
+{
+    QFETCH(int, layerCount);
+    const QList<CanvasLayer> layers = m_layers.mid(0, layerCount);
+    const int selectedLayer = layerCount / 2;
+    LayerCompositor compositor;
+    QImage frame = genFrame();
+    drawFrame(frame, compositor, layers, selectedLayer);//Builds the composites outside of the timing
+    QBENCHMARK
+    {
+        drawFrame(frame, compositor, layers, selectedLayer);
+    }
+}
+
+void BenchCompositing::rebuildComposites_data()
+{
+    layerCountData();
+}
+
+void BenchCompositing::rebuildComposites()
+{
+    QFETCH(int, layerCount);
+    const QList<CanvasLayer> layers = m_layers.mid(0, layerCount);
+    const int selectedLayer = layerCount / 2;
+    QImage frame = genFrame();
+    QBENCHMARK
+    {
+        //A new compositor has nothing built, the same as after another layer changed
+        LayerCompositor compositor;
+        drawFrame(frame, compositor, layers, selectedLayer);
+    }
+}
+
+void BenchCompositing::layerCountData()
+{
+    QTest::addColumn<int>("layerCount");
+    for(const int count : Constants::LayerCounts)
+    {
+        QTest::newRow(qPrintable(QString("%1 layers").arg(count))) << count;
+    }
+}
+
+QTEST_MAIN(BenchCompositing)
+
+#include "bench_compositing.moc"
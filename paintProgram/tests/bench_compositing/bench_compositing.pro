@@ -0,0 +1,25 @@
+QT       += core gui concurrent testlib
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+TARGET = bench_compositing
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    bench_compositing.cpp \
+    ../../layercompositor.cpp \
+    ../../mippyramid.cpp \
+    ../../pixelkernels.cpp \
+    ../../selectionmask.cpp \
+    ../../tiledimage.cpp
+
+HEADERS += \
+    ../../canvaslayer.h \
+    ../../layercompositor.h \
+    ../../mippyramid.h \
+    ../../pixelkernels.h \
+    ../../selectionmask.h \
+    ../../tiledimage.h
@@ -0,0 +1,377 @@
+#include <QtTest>
+#include <QImage>
+#include <QColor>
+#include <QThreadPool>
+#include <functional>
+#include <algorithm>
+
+#include "pixelkernels.h"
+
+namespace Constants
+{
+//4K layer - big enough that the per pixel overhead dominates, small enough that the QColor path finishes in seconds
+const int BenchWidth = 3840;
+const int BenchHeight = 2160;
+const int BenchBrightness = 20;
+const int BenchContrast = 30;
+
+//100 megapixel layer for thread scaling
+const int ScalingWidth = 10000;
+const int ScalingHeight = 10000;
+const int ThreadCounts[] = {1, 2, 4, 8, 16};
+const int BenchHue = 15;
+const int BenchSaturation = 30;
+
+//Swaps red & blue, a mix that cant be skipped as the identity
+const PixelKernels::ColorMultipliers BenchMultipliers = {0, 0, 1,
+                                                         0, 1, 0,
+                                                         1, 0, 0,
+                                                         1};
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// BenchEffects
+///
+///Whole layer effects, timed with QBENCHMARK. The "PixelColor" benchmarks are how effects went over pixels before the
+///  pixel kernels (column major, std::function, QImage::pixelColor/setPixelColor per pixel), for comparison.
+class BenchEffects : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    ///Point effects
+    void greyScalePixelColor();
+    void greyScaleScanlines();
+    void brightnessPixelColor();
+    void brightnessScanlines();
+    void invertPixelColor();
+    void invertScanlines();
+    void contrastPixelColor();
+    void contrastScanlines();
+    void colorMultipliersPixelColor();
+    void colorMultipliersScanlines();
+    void hueSaturationPixelColor();
+    void hueSaturationScanlines();
+
+    ///Thread scaling - the concurrent operations limited to a number of QThreadPool::globalInstance() threads.
+    ///  Brightness is memory bound, hue/saturation compute bound.
+    void scalingBrightness_data();
+    void scalingBrightness();
+    void scalingHueSaturation_data();
+    void scalingHueSaturation();
+
+    void cleanup();
+
+private:
+    QImage m_image;
+
+    QImage m_scalingImage;//Made on first use, its 400MB
+    const QImage& scalingImage();
+    void threadCountData();
+};
+
+namespace
+{
+
+void operateOnCanvasPixels(QImage& canvas, std::function<void (int, int)> func)
+{
+    for(int x = 0; x < canvas.width(); x++)
+    {
+        for(int y = 0; y < canvas.height(); y++)
+        {
+            func(x, y);
+        }
+    }
+}
+
+QColor greyScaleQColor(const QColor col)
+{
+    const int grey = (col.red() + col.green() + col.blue())/3;
+    return QColor(grey, grey, grey, col.alpha());
+}
+
+QColor changeBrightnessQColor(const QColor col, const int value)
+{
+    return QColor(PixelKernels::limitValidRgb(col.red() + value), PixelKernels::limitValidRgb(col.green() + value),
+                  PixelKernels::limitValidRgb(col.blue() + value), col.alpha());
+}
+
+QColor invertQColor(const QColor col)
+{
+    return QColor(PixelKernels::MaxRgbValue - col.red(), PixelKernels::MaxRgbValue - col.green(), PixelKernels::MaxRgbValue - col.blue(), col.alpha());
+}
+
+QColor changeContrastQColor(const QColor col, const int value)
+{
+    return QColor(PixelKernels::changeContrastRGOB(col.red(), value), PixelKernels::changeContrastRGOB(col.green(), value),
+                  PixelKernels::changeContrastRGOB(col.blue(), value), col.alpha());
+}
+
+QColor colorMultipliersQColor(const QColor col, const PixelKernels::ColorMultipliers& m)
+{
+    const int newR = int(col.red() * m.redXred + col.green() * m.redXgreen + col.blue() * m.redXblue);
+    const int newG = int(col.red() * m.greenXred + col.green() * m.greenXgreen + col.blue() * m.greenXblue);
+    const int newB = int(col.red() * m.blueXred + col.green() * m.blueXgreen + col.blue() * m.blueXblue);
+    return QColor(std::min(newR, PixelKernels::MaxRgbValue), std::min(newG, PixelKernels::MaxRgbValue),
+                  std::min(newB, PixelKernels::MaxRgbValue), int(col.alpha() * m.xTransparent));
+}
+
+//Through QColor's HSV conversion, as hue/saturation was before the integer kernel
+QColor hueSaturationQColor(const QColor col, const int hue, const int saturation)
+{
+    if(col.alpha() == 0)
+    {
+        return col;
+    }
+
+    int h, s, v;
+    col.getHsv(&h, &s, &v);
+    return QColor::fromHsv(PixelKernels::limitRange(h + hue, PixelKernels::MinHue, PixelKernels::MaxHue),
+                           PixelKernels::limitRange(s + saturation, PixelKernels::MinSaturation, PixelKernels::MaxSaturation), v, col.alpha());
+}
+
+}
+
+void BenchEffects::initTestCase()
+{
+    m_image = QImage(Constants::BenchWidth, Constants::BenchHeight, QImage::Format_ARGB32);
+    quint32 seed = 1;
+    PixelKernels::operateOnPixels(m_image, [&](const QRgb)-> QRgb
+    {
+        seed = seed * 1664525 + 1013904223;
+        return seed;
+    });
+}
+
+void BenchEffects::greyScalePixelColor()
+{
+    QImage image = m_image;
+    image.bits();//Detach outside of the timing
+    QBENCHMARK
+    {
+        operateOnCanvasPixels(image, [&](int x, int y)-> void
+        {
+            image.setPixelColor(x, y, greyScaleQColor(image.pixelColor(x, y)));
+        });
+    }
+}
+
+void BenchEffects::greyScaleScanlines()
+{
+    QImage image = m_image;
+    image.bits();//Detach outside of the timing
+    QBENCHMARK
+    {
+        PixelKernels::operateOnScanlines(image, [](QRgb* line, const int, const int width)-> void
+        {
+            PixelKernels::greyScale(line, width);
+        });
+    }
+}
+
+void BenchEffects::brightnessPixelColor()
+{
+    QImage image = m_image;
+    image.bits();//Detach outside of the timing
+    QBENCHMARK
+    {
+        operateOnCanvasPixels(image, [&](int x, int y)-> void
+        {
+            image.setPixelColor(x, y, changeBrightnessQColor(image.pixelColor(x, y), Constants::BenchBrightness));
+        });
+    }
+}
+
+void BenchEffects::brightnessScanlines()
+{
+    QImage image = m_image;
+    image.bits();//Detach outside of the timing
+    QBENCHMARK
+    {
+        PixelKernels::operateOnScanlines(image, [](QRgb* line, const int, const int width)-> void
+        {
+            PixelKernels::changeBrightness(line, width, Constants::BenchBrightness);
+        });
+    }
+}
+
+void BenchEffects::invertPixelColor()
+{
+    QImage image = m_image;
+    image.bits();//Detach outside of the timing
+    QBENCHMARK
+    {
+        operateOnCanvasPixels(image, [&](int x, int y)-> void
+        {
+            image.setPixelColor(x, y, invertQColor(image.pixelColor(x, y)));
+        });
+    }
+}
+
+void BenchEffects::invertScanlines()
+{
+    QImage image = m_image;
+    image.bits();//Detach outside of the timing
+    QBENCHMARK
+    {
+        PixelKernels::operateOnScanlines(image, [](QRgb* line, const int, const int width)-> void
+        {
+            PixelKernels::invert(line, width);
+        });
+    }
+}
+
+void BenchEffects::contrastPixelColor()
+{
+    QImage image = m_image;
+    image.bits();//Detach outside of the timing
+    QBENCHMARK
+    {
+        operateOnCanvasPixels(image, [&](int x, int y)-> void
+        {
+            image.setPixelColor(x, y, changeContrastQColor(image.pixelColor(x, y), Constants::BenchContrast));
+        });
+    }
+}
+
+void BenchEffects::contrastScanlines()
+{
+    QImage image = m_image;
+    image.bits();//Detach outside of the timing
+    QBENCHMARK
+    {
+        PixelKernels::operateOnScanlines(image, [](QRgb* line, const int, const int width)-> void
+        {
+            PixelKernels::changeContrast(line, width, Constants::BenchContrast);
+        });
+    }
+}
+
+void BenchEffects::colorMultipliersPixelColor()
+{
+    QImage image = m_image;
+    image.bits();//Detach outside of the timing
+    QBENCHMARK
+    {
+        operateOnCanvasPixels(image, [&](int x, int y)-> void
+        {
+            image.setPixelColor(x, y, colorMultipliersQColor(image.pixelColor(x, y), Constants::BenchMultipliers));
+        });
+    }
+}
+
+void BenchEffects::colorMultipliersScanlines()
+{
+    QImage image = m_image;
+    image.bits();//Detach outside of the timing
+    QBENCHMARK
+    {
+        PixelKernels::operateOnScanlines(image, [](QRgb* line, const int, const int width)-> void
+        {
+            PixelKernels::colorMultipliers(line, width, Constants::BenchMultipliers);
+        });
+    }
+}
+
+void BenchEffects::hueSaturationPixelColor()
+{
+    QImage image = m_image;
+    image.bits();//Detach outside of the timing
+    QBENCHMARK
+    {
+        operateOnCanvasPixels(image, [&](int x, int y)-> void
+        {
+            image.setPixelColor(x, y, hueSaturationQColor(image.pixelColor(x, y), Constants::BenchHue, Constants::BenchSaturation));
+        });
+    }
+}
+
+void BenchEffects::hueSaturationScanlines()
+{
+    QImage image = m_image;
+    image.bits();//Detach outside of the timing
+    QBENCHMARK
+    {
+        PixelKernels::operateOnScanlines(image, [](QRgb* line, const int, const int width)-> void
+        {
+            PixelKernels::hueAndSaturation(line, width, Constants::BenchHue, Constants::BenchSaturation);
+        });
+    }
+}
+
+void BenchEffects::scalingBrightness_data()
+{
+    threadCountData();
+}
+
+void BenchEffects::scalingBrightness()
+{
+    QFETCH(int, threads);
+    QThreadPool::globalInstance()->setMaxThreadCount(threads);
+
+    QImage image = scalingImage();
+    image.bits();//Detach outside of the timing
+    QBENCHMARK
+    {
+        PixelKernels::operateOnScanlinesConcurrent(image, [](QRgb* line, const int, const int width)-> void
+        {
+            PixelKernels::changeBrightness(line, width, Constants::BenchBrightness);
+        });
+    }
+}
+
+void BenchEffects::scalingHueSaturation_data()
+{
+    threadCountData();
+}
+
+void BenchEffects::scalingHueSaturation()
+{
+    QFETCH(int, threads);
+    QThreadPool::globalInstance()->setMaxThreadCount(threads);
+
+    QImage image = scalingImage();
+    image.bits();//Detach outside of the timing
+    QBENCHMARK
+    {
+        PixelKernels::operateOnScanlinesConcurrent(image, [](QRgb* line, const int, const int width)-> void
+        {
+            PixelKernels::hueAndSaturation(line, width, Constants::BenchHue, Constants::BenchSaturation);
+        });
+    }
+}
+
+void BenchEffects::cleanup()
+{
+    QThreadPool::globalInstance()->setMaxThreadCount(QThread::idealThreadCount());
+}
+
+const QImage& BenchEffects::scalingImage()
+{
+    if(m_scalingImage.isNull())
+    {
+        m_scalingImage = QImage(Constants::ScalingWidth, Constants::ScalingHeight, QImage::Format_ARGB32);
+        quint32 seed = 1;
+        PixelKernels::operateOnPixels(m_scalingImage, [&](const QRgb)-> QRgb
+        {
+            seed = seed * 1664525 + 1013904223;
+            return seed;
+        });
+    }
+    return m_scalingImage;
+}
+
+void BenchEffects::threadCountData()
+{
+    QTest::addColumn<int>("threads");
+    for(const int threads : Constants::ThreadCounts)
+    {
+        QTest::newRow(qPrintable(QString("%1 threads").arg(threads))) << threads;
+    }
+}
+
+QTEST_GUILESS_MAIN(BenchEffects)
+
+#include "bench_effects.moc"
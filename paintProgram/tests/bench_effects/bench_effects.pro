@@ -0,0 +1,18 @@
+QT       += core gui concurrent testlib
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+TARGET = bench_effects
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    bench_effects.cpp \
+    ../../pixelkernels.cpp \
+    ../../selectionmask.cpp
+
+HEADERS += \
+    ../../pixelkernels.h \
+    ../../selectionmask.h
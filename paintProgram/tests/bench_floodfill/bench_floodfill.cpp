@@ -0,0 +1,265 @@
+#include <QtTest>
+#include <QImage>
+#include <QColor>
+#include <QVector>
+#include <stack>
+
+#include "floodfill.h"
+
+namespace Constants
+{
+//1080p layer - the "Stack" fills push 4 points per filled pixel, so much bigger & they take minutes
+const int BenchWidth = 1920;
+const int BenchHeight = 1080;
+const int BenchSensitivity = 10;
+
+const QRgb BackgroundColor = qRgba(0, 0, 0, 0);
+const QRgb WallColor = qRgba(255, 255, 255, 255);
+const QRgb FillColor = qRgba(200, 40, 40, 255);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// BenchFloodFill
+///
+///Bucket fill & spread select, timed with QBENCHMARK. The "Stack" benchmarks are how they worked before the scanline
+///  fill (a std::stack seed per neighbour of every filled pixel, QImage::pixelColor per pixel), for comparison.
+///Each runs on two layers, both filled from (0, 0):
+///  "uniform"      - one colour, so the whole layer is one region of full width spans
+///  "checkerboard" - every other pixel of every other row is a wall, so half the rows are split into 1 pixel spans.
+///                   The worst case for the scanline fill, which stacks a seed per span.
+class BenchFloodFill : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void scanlineFloodFill_data();
+    void scanlineFloodFill();
+
+    void spreadSelectStack_data();
+    void spreadSelectStack();
+    void spreadSelectScanline_data();
+    void spreadSelectScanline();
+
+    void floodFillStack_data();
+    void floodFillStack();
+    void floodFillScanline_data();
+    void floodFillScanline();
+
+private:
+    QImage m_uniformImage;
+    QImage m_checkerboardImage;
+
+    void patternData();
+};
+
+namespace
+{
+
+void spreadSelectSimilarColorStack(QImage& image, QVector<QVector<bool>>& selectedPixels, QPoint startPixel, int sensitivty)
+{
+    if(startPixel.x() > image.width() || startPixel.x() < 0 || startPixel.y() > image.height() || startPixel.y() < 0)
+        return;
+
+    const QColor colorToSpreadOver = image.pixelColor(startPixel);
+
+    std::stack<QPoint> stack;
+    stack.push(startPixel);
+
+    while (stack.size() > 0)
+    {
+        QPoint p = stack.top();
+        stack.pop();
+        const int x = p.x();
+        const int y = p.y();
+        if (y < 0 || y >= image.height() || x < 0 || x >= image.width())
+            continue;
+
+        const QColor pixelColor = image.pixelColor(x,y);
+        if (selectedPixels[x][y] == false &&
+            pixelColor.red() <= colorToSpreadOver.red() + sensitivty && pixelColor.red() >= colorToSpreadOver.red() - sensitivty &&
+            pixelColor.green() <= colorToSpreadOver.green() + sensitivty && pixelColor.green() >= colorToSpreadOver.green() - sensitivty &&
+            pixelColor.blue() <= colorToSpreadOver.blue() + sensitivty && pixelColor.blue() >= colorToSpreadOver.blue() - sensitivty &&
+            pixelColor.alpha() <= colorToSpreadOver.alpha() + sensitivty && pixelColor.alpha() >= colorToSpreadOver.alpha() - sensitivty
+            )
+        {
+            selectedPixels[x][y] = true;
+            stack.push(QPoint(x + 1, y));
+            stack.push(QPoint(x - 1, y));
+            stack.push(QPoint(x, y + 1));
+            stack.push(QPoint(x, y - 1));
+        }
+    }
+}
+
+void floodFillOnSimilarStack(QImage &image, QColor newColor, int startX, int startY, int sensitivity)
+{
+    if(startX < image.width() && startX > -1 && startY < image.height() && startY > -1)
+    {
+        const QColor originalPixelColor = QColor(image.pixel(startX, startY));
+
+        std::stack<QPoint> stack;
+        stack.push(QPoint(startX,startY));
+
+        while (stack.size() > 0)
+        {
+            QPoint p = stack.top();
+            stack.pop();
+            const int x = p.x();
+            const int y = p.y();
+            if (y < 0 || y >= image.height() || x < 0 || x >= image.width())
+                continue;
+
+            const QColor pixelColor = image.pixelColor(x,y);
+            if (
+                //Check pixel color in sensitivity range
+                pixelColor.red() <= originalPixelColor.red() + sensitivity && pixelColor.red() >= originalPixelColor.red() - sensitivity &&
+                pixelColor.green() <= originalPixelColor.green() + sensitivity && pixelColor.green() >= originalPixelColor.green() - sensitivity &&
+                pixelColor.blue() <= originalPixelColor.blue() + sensitivity && pixelColor.blue() >= originalPixelColor.blue() - sensitivity &&
+
+                //Check not excat same color
+                pixelColor != newColor
+                    )
+            {
+                //Switch color
+                image.setPixelColor(x, y, newColor);
+
+                stack.push(QPoint(x + 1, y));
+                stack.push(QPoint(x - 1, y));
+                stack.push(QPoint(x, y + 1));
+                stack.push(QPoint(x, y - 1));
+            }
+        }
+    }
+}
+
+}
+
+void BenchFloodFill::initTestCase()
+{
+    m_uniformImage = QImage(Constants::BenchWidth, Constants::BenchHeight, QImage::Format_ARGB32);
+    m_uniformImage.fill(Constants::BackgroundColor);
+
+    m_checkerboardImage = m_uniformImage.copy();
+    for(int y = 1; y < m_checkerboardImage.height(); y += 2)
+    {
+        QRgb* line = reinterpret_cast<QRgb*>(m_checkerboardImage.scanLine(y));
+        for(int x = 1; x < m_checkerboardImage.width(); x += 2)
+        {
+            line[x] = Constants::WallColor;
+        }
+    }
+
+    //The scanline fills must select the same pixels as the fills they replaced
+    for(const QImage& image : {m_uniformImage, m_checkerboardImage})
+    {
+        QImage stackImage = image;
+        QVector<QVector<bool>> stackSelection(image.width(), QVector<bool>(image.height(), false));
+        spreadSelectSimilarColorStack(stackImage, stackSelection, QPoint(0, 0), Constants::BenchSensitivity);
+        QBitArray stackSelectionBits(image.width() * image.height());
+        for(int y = 0; y < image.height(); y++)
+        {
+            for(int x = 0; x < image.width(); x++)
+            {
+                stackSelectionBits.setBit(y * image.width() + x, stackSelection[x][y]);
+            }
+        }
+        QCOMPARE(FloodFill::spreadSelectSimilarColor(image, QPoint(0, 0), Constants::BenchSensitivity), stackSelectionBits);
+
+        floodFillOnSimilarStack(stackImage, QColor::fromRgba(Constants::FillColor), 0, 0, Constants::BenchSensitivity);
+        QImage scanlineImage = image;
+        FloodFill::floodFillOnSimilar(scanlineImage, QColor::fromRgba(Constants::FillColor), 0, 0, Constants::BenchSensitivity);
+        QCOMPARE(scanlineImage, stackImage);
+    }
+}
+
+void BenchFloodFill::scanlineFloodFill_data()
+{
+    patternData();
+}
+
+//Just the fill, with the cheapest check
+void BenchFloodFill::scanlineFloodFill()
+{
+    QFETCH(QImage, image);
+    const QRgb startColor = image.pixel(0, 0);
+    QBENCHMARK
+    {
+        FloodFill::scanlineFloodFill(image, QPoint(0, 0), [&](const QRgb pixelColor)-> bool
+        {
+            return pixelColor == startColor;
+        });
+    }
+}
+
+void BenchFloodFill::spreadSelectStack_data()
+{
+    patternData();
+}
+
+void BenchFloodFill::spreadSelectStack()
+{
+    QFETCH(QImage, image);
+    QBENCHMARK
+    {
+        QVector<QVector<bool>> selectedPixels(image.width(), QVector<bool>(image.height(), false));
+        spreadSelectSimilarColorStack(image, selectedPixels, QPoint(0, 0), Constants::BenchSensitivity);
+    }
+}
+
+void BenchFloodFill::spreadSelectScanline_data()
+{
+    patternData();
+}
+
+void BenchFloodFill::spreadSelectScanline()
+{
+    QFETCH(QImage, image);
+    QBENCHMARK
+    {
+        FloodFill::spreadSelectSimilarColor(image, QPoint(0, 0), Constants::BenchSensitivity);
+    }
+}
+
+void BenchFloodFill::floodFillStack_data()
+{
+    patternData();
+}
+
+//Both fill benchmarks copy the layer each iteration (a filled layer has nothing left to fill), so include a memcpy of it
+void BenchFloodFill::floodFillStack()
+{
+    QFETCH(QImage, image);
+    QBENCHMARK
+    {
+        QImage filledImage = image.copy();
+        floodFillOnSimilarStack(filledImage, QColor::fromRgba(Constants::FillColor), 0, 0, Constants::BenchSensitivity);
+    }
+}
+
+void BenchFloodFill::floodFillScanline_data()
+{
+    patternData();
+}
+
+void BenchFloodFill::floodFillScanline()
+{
+    QFETCH(QImage, image);
+    QBENCHMARK
+    {
+        QImage filledImage = image.copy();
+        FloodFill::floodFillOnSimilar(filledImage, QColor::fromRgba(Constants::FillColor), 0, 0, Constants::BenchSensitivity);
+    }
+}
+
+void BenchFloodFill::patternData()
+{
+    QTest::addColumn<QImage>("image");
+    QTest::newRow("uniform") << m_uniformImage;
+    QTest::newRow("checkerboard") << m_checkerboardImage;
+}
+
+QTEST_GUILESS_MAIN(BenchFloodFill)
+
+#include "bench_floodfill.moc"
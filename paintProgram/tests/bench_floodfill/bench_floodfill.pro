@@ -0,0 +1,20 @@
+QT       += core gui concurrent testlib
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+TARGET = bench_floodfill
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    bench_floodfill.cpp \
+    ../../floodfill.cpp \
+    ../../pixelkernels.cpp \
+    ../../selectionmask.cpp
+
+HEADERS += \
+    ../../floodfill.h \
+    ../../pixelkernels.h \
+    ../../selectionmask.h
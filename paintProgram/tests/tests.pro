@@ -0,0 +1,9 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    tst_pixelkernels \
+    tst_selectionmask \
+    bench_effects \
+    bench_canvasfile \
+    bench_compositing \
+    bench_floodfill
@@ -0,0 +1,534 @@
+#include <QtTest>
+#include <QImage>
+#include <QColor>
+#include <QVector>
+#include <functional>
+
+#include "pixelkernels.h"
+
+namespace Constants
+{
+//Widths around the SSE2 (4) & AVX2 (8) pixel steps, so every tail length gets run, plus lines longer than a chunk
+const int LineWidths[] = {1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 1000, 4099};
+const int ReferenceImageWidth = 257;
+const int ReferenceImageHeight = 131;
+
+//Own copies, so the references dont depend on PixelKernels
+const int MinRgbValue = 0;
+const int MiddleRgbValue = 127;
+const int MaxRgbValue = 255;
+const int MinHue = 0;
+const int MaxHue = 179;
+const int MinSaturation = 0;
+const int MaxSaturation = 255;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// TestPixelKernels
+///
+///The SIMD scanline kernels must give bit for bit what the scalar versions do, and the scalar versions what the
+///  effects gave when they went through QColor per pixel (within a kernel's tolerance, for hue/saturation).
+class TestPixelKernels : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void cleanup();
+
+    ///Color adjustments
+    void simdMatchesScalar_data();
+    void simdMatchesScalar();
+    void scalarMatchesQColor();
+
+    ///Fused adjustments
+    void channelLuts();
+    void adjustMatchesChain_data();
+    void adjustMatchesChain();
+};
+
+namespace
+{
+
+struct AdjustmentsCase
+{
+    const char* name;
+    PixelKernels::Adjustments adjustments;
+};
+
+struct KernelCase
+{
+    const char* name;
+    std::function<void (QRgb*, int)> scanlineKernel;
+    std::function<QColor (const QColor&)> qColorKernel;//As the effect was before the pixel kernels
+    int qColorTolerance = 0;//Most each channel can differ from qColorKernel by
+};
+
+//Deterministic, so failures reproduce
+QVector<QRgb> randomLine(const int width, quint32 seed)
+{
+    QVector<QRgb> line(width);
+    for(int x = 0; x < width; x++)
+    {
+        seed = seed * 1664525 + 1013904223;
+        line[x] = seed;
+    }
+    return line;
+}
+
+//limitMax -> changeContrastRGOB are as they were in canvas.cpp before the pixel kernels, so the QColor references
+//  dont share code with the kernels they check
+int limitMax(const int& value, const int& max)
+{
+    if(value > max)
+    {
+        return max;
+    }
+    return value;
+}
+
+int limitMin(const int& value, const int& min)
+{
+    if(value < min)
+    {
+        return min;
+    }
+    return value;
+}
+
+int limitRange(const int& value, const int& min, const int& max)
+{
+    if(value > max)
+    {
+        return max;
+    }
+
+    if(value < min)
+    {
+        return min;
+    }
+
+    return value;
+}
+
+int limitValidRgb(const int& num)
+{
+    return limitRange(num, Constants::MinRgbValue, Constants::MaxRgbValue);
+}
+
+int changeContrastRGOB(const int rgob, const int value) // rgob --> stands for red, green or blue
+{
+    //Constants::MiddleRgbValue is middle of Constants::MinRgbValue and Constants::MaxRgbValue, dulling contrast(<0) moves towards MiddleRgbValue, high contrast(>0) moves away.
+
+    if(rgob > Constants::MiddleRgbValue)
+    {
+        if(value > 0)
+        {
+            return limitMax(rgob + value, Constants::MaxRgbValue);
+        }
+        else if(value < 0)
+        {
+            return limitMin(rgob + value, Constants::MiddleRgbValue);
+        }
+    }
+    else if(rgob < Constants::MiddleRgbValue)
+    {
+        if(value > 0)
+        {
+            return limitMin(rgob - value, Constants::MinRgbValue);
+        }
+        else if(value < 0)
+        {
+            return limitMax(rgob - value, Constants::MiddleRgbValue);
+        }
+    }
+
+    return rgob;
+}
+
+bool withinTolerance(const QRgb a, const QRgb b, const int tolerance)
+{
+    return qAbs(qRed(a) - qRed(b)) <= tolerance && qAbs(qGreen(a) - qGreen(b)) <= tolerance &&
+           qAbs(qBlue(a) - qBlue(b)) <= tolerance && qAbs(qAlpha(a) - qAlpha(b)) <= tolerance;
+}
+
+QVector<KernelCase> colorAdjustmentCases()
+{
+    QVector<KernelCase> cases;
+
+    cases.push_back({"greyScale", [](QRgb* line, const int width)-> void
+    {
+        PixelKernels::greyScale(line, width);
+    }, [](const QColor& col)-> QColor
+    {
+        const int grey = (col.red() + col.green() + col.blue())/3;
+        return QColor(grey, grey, grey, col.alpha());
+    }});
+
+    cases.push_back({"invert", [](QRgb* line, const int width)-> void
+    {
+        PixelKernels::invert(line, width);
+    }, [](const QColor& col)-> QColor
+    {
+        return QColor(Constants::MaxRgbValue - col.red(), Constants::MaxRgbValue - col.green(), Constants::MaxRgbValue - col.blue(), col.alpha());
+    }});
+
+    for(const int value : {-255, -40, -1, 1, 37, 255})
+    {
+        cases.push_back({"changeBrightness", [value](QRgb* line, const int width)-> void
+        {
+            PixelKernels::changeBrightness(line, width, value);
+        }, [value](const QColor& col)-> QColor
+        {
+            return QColor(limitValidRgb(col.red() + value), limitValidRgb(col.green() + value), limitValidRgb(col.blue() + value), col.alpha());
+        }});
+    }
+
+    for(const int value : {-255, -128, -30, 1, 30, 128, 255})
+    {
+        cases.push_back({"changeContrast", [value](QRgb* line, const int width)-> void
+        {
+            PixelKernels::changeContrast(line, width, value);
+        }, [value](const QColor& col)-> QColor
+        {
+            return QColor(changeContrastRGOB(col.red(), value), changeContrastRGOB(col.green(), value), changeContrastRGOB(col.blue(), value), col.alpha());
+        }});
+    }
+
+    PixelKernels::ColorMultipliers sepia;
+    sepia.redXred = 0.39f;
+    sepia.redXgreen = 0.77f;
+    sepia.redXblue = 0.19f;
+    sepia.greenXred = 0.35f;
+    sepia.greenXgreen = 0.69f;
+    sepia.greenXblue = 0.17f;
+    sepia.blueXred = 0.27f;
+    sepia.blueXgreen = 0.53f;
+    sepia.blueXblue = 0.13f;
+    sepia.xTransparent = 0.5f;
+    PixelKernels::ColorMultipliers boost;
+    boost.redXred = 1.5f;
+    boost.greenXgreen = 2.0f;
+    boost.blueXblue = 0.33f;
+    boost.redXblue = 0.1f;
+    for(const PixelKernels::ColorMultipliers& m : {sepia, boost})
+    {
+        cases.push_back({"colorMultipliers", [m](QRgb* line, const int width)-> void
+        {
+            PixelKernels::colorMultipliers(line, width, m);
+        }, [m](const QColor& col)-> QColor
+        {
+            const int newR = limitMax(col.red() * m.redXred + col.green() * m.redXgreen + col.blue() * m.redXblue, Constants::MaxRgbValue);
+            const int newG = limitMax(col.red() * m.greenXred + col.green() * m.greenXgreen + col.blue() * m.greenXblue, Constants::MaxRgbValue);
+            const int newB = limitMax(col.red() * m.blueXred + col.green() * m.blueXgreen + col.blue() * m.blueXblue, Constants::MaxRgbValue);
+            const int newA = col.alpha() * m.xTransparent;
+            return QColor(newR, newG, newB, newA);
+        }});
+    }
+
+    //Integer HSV steps stand in for QColor's 16 bit double ones, so can be 1 out. Includes 0/0, which still clamps
+    //  hues past MaxHue.
+    const QVector<QPair<int, int>> hueSaturations = {{0, 0}, {15, 30}, {-40, -100}, {90, 0}, {179, 255}, {-179, -255}};
+    for(const QPair<int, int>& hueSaturation : hueSaturations)
+    {
+        const int hue = hueSaturation.first;
+        const int saturation = hueSaturation.second;
+        cases.push_back({"hueAndSaturation", [hue, saturation](QRgb* line, const int width)-> void
+        {
+            PixelKernels::hueAndSaturation(line, width, hue, saturation);
+        }, [hue, saturation](const QColor& col)-> QColor
+        {
+            if(col.alpha() == 0)
+            {
+                return col;
+            }
+
+            int h,s,v;
+            col.getHsv(&h, &s, &v);
+            return QColor::fromHsv(limitRange(h + hue, Constants::MinHue, Constants::MaxHue),
+                                   limitRange(s + saturation, Constants::MinSaturation, Constants::MaxSaturation), v, col.alpha());
+        }, 1});
+    }
+
+    return cases;
+}
+
+//The stacks the fused pass is checked with - each per channel path (brightness/contrast kernels, table), with and
+//  without the stages after it
+QVector<AdjustmentsCase> adjustmentsCases()
+{
+    PixelKernels::Levels levels;
+    levels.inputBlack = 10;
+    levels.inputWhite = 240;
+    levels.gamma = 1.4f;
+    levels.outputBlack = 5;
+    levels.outputWhite = 250;
+
+    PixelKernels::ColorMultipliers sepia;
+    sepia.redXred = 0.39f;
+    sepia.redXgreen = 0.77f;
+    sepia.redXblue = 0.19f;
+    sepia.greenXred = 0.35f;
+    sepia.greenXgreen = 0.69f;
+    sepia.greenXblue = 0.17f;
+    sepia.blueXred = 0.27f;
+    sepia.blueXgreen = 0.53f;
+    sepia.blueXblue = 0.13f;
+    sepia.xTransparent = 0.5f;
+
+    QVector<AdjustmentsCase> cases;
+    cases.push_back({"identity", PixelKernels::Adjustments()});
+
+    AdjustmentsCase brightness = {"brightness", PixelKernels::Adjustments()};
+    brightness.adjustments.brightness = 37;
+    cases.push_back(brightness);
+
+    AdjustmentsCase contrast = {"contrast", PixelKernels::Adjustments()};
+    contrast.adjustments.contrast = -30;
+    cases.push_back(contrast);
+
+    AdjustmentsCase brightnessContrast = {"brightness & contrast", PixelKernels::Adjustments()};
+    brightnessContrast.adjustments.brightness = 20;
+    brightnessContrast.adjustments.contrast = 60;
+    cases.push_back(brightnessContrast);
+
+    AdjustmentsCase levelsOnly = {"levels", PixelKernels::Adjustments()};
+    levelsOnly.adjustments.levels = levels;
+    cases.push_back(levelsOnly);
+
+    AdjustmentsCase tableMultipliers = {"brightness, levels & multipliers", PixelKernels::Adjustments()};
+    tableMultipliers.adjustments.brightness = -15;
+    tableMultipliers.adjustments.levels = levels;
+    tableMultipliers.adjustments.multipliers = sepia;
+    cases.push_back(tableMultipliers);
+
+    AdjustmentsCase everything = {"everything", PixelKernels::Adjustments()};
+    everything.adjustments.brightness = 12;
+    everything.adjustments.contrast = 25;
+    everything.adjustments.levels = levels;
+    everything.adjustments.multipliers = sepia;
+    everything.adjustments.hue = 15;
+    everything.adjustments.saturation = 30;
+    cases.push_back(everything);
+
+    AdjustmentsCase hueSaturationZero = {"hue/saturation at 0/0", PixelKernels::Adjustments()};
+    hueSaturationZero.adjustments.hueSaturation = true;
+    cases.push_back(hueSaturationZero);
+
+    return cases;
+}
+
+//As the adjustments were applied before they were fused - each stage a whole pass over line, in Adjustments order
+void adjustByStages(QRgb* line, const int width, const PixelKernels::Adjustments& adjustments)
+{
+    if(adjustments.brightness != 0)
+    {
+        PixelKernels::changeBrightness(line, width, adjustments.brightness);
+    }
+    if(adjustments.contrast != 0)
+    {
+        PixelKernels::changeContrast(line, width, adjustments.contrast);
+    }
+    if(!adjustments.levels.isIdentity())
+    {
+        PixelKernels::applyLut(line, width, PixelKernels::levelsLut(adjustments.levels));
+    }
+    if(!PixelKernels::isIdentity(adjustments.multipliers))
+    {
+        PixelKernels::colorMultipliers(line, width, adjustments.multipliers);
+    }
+    if(adjustments.hueSaturation || adjustments.hue != 0 || adjustments.saturation != 0)
+    {
+        PixelKernels::hueAndSaturation(line, width, adjustments.hue, adjustments.saturation);
+    }
+}
+
+QString argbText(const QRgb col)
+{
+    return QString("%1").arg(col, 8, 16, QChar('0'));
+}
+
+}
+
+void TestPixelKernels::cleanup()
+{
+    PixelKernels::setSimdLevel(PixelKernels::detectedSimdLevel());
+}
+
+void TestPixelKernels::simdMatchesScalar_data()
+{
+    QTest::addColumn<int>("simdLevel");
+    QTest::addColumn<int>("width");
+
+    for(const int width : Constants::LineWidths)
+    {
+        QTest::newRow(qPrintable(QString("SSE2, width %1").arg(width))) << int(PixelKernels::SimdLevel::SSE2) << width;
+        QTest::newRow(qPrintable(QString("AVX2, width %1").arg(width))) << int(PixelKernels::SimdLevel::AVX2) << width;
+    }
+}
+
+void TestPixelKernels::simdMatchesScalar()
+{
+    QFETCH(int, simdLevel);
+    QFETCH(int, width);
+
+    if(simdLevel > int(PixelKernels::detectedSimdLevel()))
+    {
+        QSKIP("Instruction set not supported by this cpu");
+    }
+
+    for(const KernelCase& kernelCase : colorAdjustmentCases())
+    {
+        //Starts 1 pixel into the buffer so loads/stores arent aligned
+        const QVector<QRgb> original = randomLine(width + 1, quint32(width));
+
+        QVector<QRgb> scalarLine = original;
+        PixelKernels::setSimdLevel(PixelKernels::SimdLevel::Scalar);
+        kernelCase.scanlineKernel(scalarLine.data() + 1, width);
+
+        QVector<QRgb> simdLine = original;
+        PixelKernels::setSimdLevel(PixelKernels::SimdLevel(simdLevel));
+        kernelCase.scanlineKernel(simdLine.data() + 1, width);
+
+        for(int x = 0; x <= width; x++)
+        {
+            const bool same = simdLine[x] == scalarLine[x];
+            QVERIFY2(same, same ? "" : qPrintable(QString("%1 differs at pixel %2: SIMD %3, scalar %4").arg(kernelCase.name).arg(x - 1)
+                                                   .arg(argbText(simdLine[x])).arg(argbText(scalarLine[x]))));
+        }
+    }
+}
+
+void TestPixelKernels::scalarMatchesQColor()
+{
+    PixelKernels::setSimdLevel(PixelKernels::SimdLevel::Scalar);
+
+    QImage original(Constants::ReferenceImageWidth, Constants::ReferenceImageHeight, QImage::Format_ARGB32);
+    quint32 seed = 1;
+    PixelKernels::operateOnPixels(original, [&](const QRgb)-> QRgb
+    {
+        seed = seed * 1664525 + 1013904223;
+        return seed;
+    });
+
+    for(const KernelCase& kernelCase : colorAdjustmentCases())
+    {
+        QImage image = original;
+        PixelKernels::operateOnScanlines(image, [&](QRgb* line, const int, const int width)-> void
+        {
+            kernelCase.scanlineKernel(line, width);
+        });
+
+        QImage reference = original;
+        for(int x = 0; x < reference.width(); x++)
+        {
+            for(int y = 0; y < reference.height(); y++)
+            {
+                reference.setPixelColor(x, y, kernelCase.qColorKernel(reference.pixelColor(x, y)));
+            }
+        }
+
+        for(int y = 0; y < image.height(); y++)
+        {
+            for(int x = 0; x < image.width(); x++)
+            {
+                const bool within = withinTolerance(image.pixel(x, y), reference.pixel(x, y), kernelCase.qColorTolerance);
+                QVERIFY2(within, within ? "" : qPrintable(QString("%1 differs from its QColor version at %2, %3: kernel %4, QColor %5")
+                                                           .arg(kernelCase.name).arg(x).arg(y)
+                                                           .arg(argbText(image.pixel(x, y))).arg(argbText(reference.pixel(x, y)))));
+            }
+        }
+    }
+}
+
+void TestPixelKernels::channelLuts()
+{
+    const PixelKernels::ChannelLut identity = PixelKernels::identityLut();
+    const PixelKernels::ChannelLut levelsIdentity = PixelKernels::levelsLut(PixelKernels::Levels());
+    for(int i = Constants::MinRgbValue; i <= Constants::MaxRgbValue; i++)
+    {
+        QCOMPARE(int(identity.values[i]), i);
+        QCOMPARE(int(levelsIdentity.values[i]), i);
+    }
+
+    for(const int value : {-255, -128, -30, -1, 0, 1, 30, 128, 255})
+    {
+        const PixelKernels::ChannelLut brightness = PixelKernels::brightnessLut(value);
+        const PixelKernels::ChannelLut contrast = PixelKernels::contrastLut(value);
+        const PixelKernels::ChannelLut composed = PixelKernels::composedLut(brightness, contrast);
+        for(int i = Constants::MinRgbValue; i <= Constants::MaxRgbValue; i++)
+        {
+            QVERIFY2(brightness.values[i] == limitValidRgb(i + value), qPrintable(QString("brightnessLut(%1) at %2").arg(value).arg(i)));
+            QVERIFY2(contrast.values[i] == changeContrastRGOB(i, value), qPrintable(QString("contrastLut(%1) at %2").arg(value).arg(i)));
+            QVERIFY2(composed.values[i] == changeContrastRGOB(limitValidRgb(i + value), value), qPrintable(QString("composedLut(%1) at %2").arg(value).arg(i)));
+        }
+    }
+
+    //Black & white points map to the output points, gamma > 1 lifts the mid tones
+    PixelKernels::Levels levels;
+    levels.inputBlack = 10;
+    levels.inputWhite = 240;
+    levels.gamma = 1.4f;
+    levels.outputBlack = 5;
+    levels.outputWhite = 250;
+    const PixelKernels::ChannelLut levelsTable = PixelKernels::levelsLut(levels);
+    QCOMPARE(int(levelsTable.values[0]), levels.outputBlack);
+    QCOMPARE(int(levelsTable.values[levels.inputBlack]), levels.outputBlack);
+    QCOMPARE(int(levelsTable.values[levels.inputWhite]), levels.outputWhite);
+    QCOMPARE(int(levelsTable.values[Constants::MaxRgbValue]), levels.outputWhite);
+    QVERIFY(levelsTable.values[Constants::MiddleRgbValue] > Constants::MiddleRgbValue);
+    for(int i = Constants::MinRgbValue + 1; i <= Constants::MaxRgbValue; i++)
+    {
+        QVERIFY2(levelsTable.values[i] >= levelsTable.values[i - 1], qPrintable(QString("levelsLut decreases at %1").arg(i)));
+    }
+}
+
+void TestPixelKernels::adjustMatchesChain_data()
+{
+    QTest::addColumn<int>("simdLevel");
+
+    QTest::newRow("Scalar") << int(PixelKernels::SimdLevel::Scalar);
+    QTest::newRow("SSE2") << int(PixelKernels::SimdLevel::SSE2);
+    QTest::newRow("AVX2") << int(PixelKernels::SimdLevel::AVX2);
+}
+
+//The fused pass (adjust & adjustPixel) must give bit for bit what running each adjustment as its own pass does
+void TestPixelKernels::adjustMatchesChain()
+{
+    QFETCH(int, simdLevel);
+
+    if(simdLevel > int(PixelKernels::detectedSimdLevel()))
+    {
+        QSKIP("Instruction set not supported by this cpu");
+    }
+    PixelKernels::setSimdLevel(PixelKernels::SimdLevel(simdLevel));
+
+    for(const AdjustmentsCase& adjustmentsCase : adjustmentsCases())
+    {
+        const PixelKernels::PreparedAdjustments prepared = PixelKernels::prepareAdjustments(adjustmentsCase.adjustments);
+
+        for(const int width : Constants::LineWidths)
+        {
+            //Starts 1 pixel into the buffer so loads/stores arent aligned
+            const QVector<QRgb> original = randomLine(width + 1, quint32(width));
+
+            QVector<QRgb> stagesLine = original;
+            adjustByStages(stagesLine.data() + 1, width, adjustmentsCase.adjustments);
+
+            QVector<QRgb> fusedLine = original;
+            PixelKernels::adjust(fusedLine.data() + 1, width, prepared);
+
+            for(int x = 0; x <= width; x++)
+            {
+                const QRgb pixel = x == 0 ? original[x] : PixelKernels::adjustPixel(original[x], prepared);
+                const bool same = fusedLine[x] == stagesLine[x] && pixel == stagesLine[x];
+                QVERIFY2(same, same ? "" : qPrintable(QString("%1, width %2, differs at pixel %3: adjust %4, adjustPixel %5, stages %6")
+                                                       .arg(adjustmentsCase.name).arg(width).arg(x - 1)
+                                                       .arg(argbText(fusedLine[x])).arg(argbText(pixel)).arg(argbText(stagesLine[x]))));
+            }
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(TestPixelKernels)
+
+#include "tst_pixelkernels.moc"
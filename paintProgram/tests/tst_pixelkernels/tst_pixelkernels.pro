@@ -0,0 +1,18 @@
+QT       += core gui concurrent testlib
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TEMPLATE = app
+TARGET = tst_pixelkernels
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    tst_pixelkernels.cpp \
+    ../../pixelkernels.cpp \
+    ../../selectionmask.cpp
+
+HEADERS += \
+    ../../pixelkernels.h \
+    ../../selectionmask.h
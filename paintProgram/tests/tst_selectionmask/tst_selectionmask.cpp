@@ -0,0 +1,272 @@
+#include <QtTest>
+#include <QBitArray>
+#include <QPainterPath>
+#include <QSet>
+#include <QPair>
+#include <QVector>
+
+#include "selectionmask.h"
+
+namespace Constants
+{
+const int RandomMaskCount = 200;
+const int MaxMaskSize = 40;
+const int MaxOffset = 20;
+
+//Fraction (of 4) of pixels selected - sparse masks have lots of single pixel spans & corners, dense ones long spans & holes
+const int Densities[] = {1, 2, 3};
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// TestSelectionMask
+///
+///SelectionMask against brute force, per pixel versions of the same thing, on random masks (random sizes, densities &
+///  offsets, so spans start/end on every side of each other).
+class TestSelectionMask : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void info();
+    void translated();
+    void united();
+    void intersected();
+    void outlinePath();
+};
+
+namespace
+{
+
+//Deterministic, so failures reproduce
+class Random
+{
+public:
+    explicit Random(const quint32& seed) :
+        m_seed(seed)
+    {
+    }
+
+    int next(const int& max)
+    {
+        m_seed = m_seed * 1664525 + 1013904223;
+        return int((m_seed >> 8) % quint32(max));
+    }
+
+private:
+    quint32 m_seed;
+};
+
+//Mask with every pixel of a random size rect selected at a random density, moved by a random offset
+SelectionMask randomMask(Random& random)
+{
+    const int width = 1 + random.next(Constants::MaxMaskSize);
+    const int height = 1 + random.next(Constants::MaxMaskSize);
+    const int density = Constants::Densities[random.next(3)];
+
+    QBitArray bits(width * height);
+    for(int i = 0; i < bits.size(); i++)
+    {
+        bits.setBit(i, random.next(4) < density);
+    }
+    return SelectionMask::fromBits(bits, width, height).translated(random.next(2 * Constants::MaxOffset + 1) - Constants::MaxOffset,
+                                                                   random.next(2 * Constants::MaxOffset + 1) - Constants::MaxOffset);
+}
+
+//Covers every pixel any of the masks could have selected, plus a border of unselected pixels
+QRect testArea()
+{
+    const int extent = Constants::MaxOffset + Constants::MaxMaskSize + 2;
+    return QRect(QPoint(-extent, -extent), QPoint(extent, extent));
+}
+
+QString pixelText(const int& x, const int& y)
+{
+    return QString("%1, %2").arg(x).arg(y);
+}
+
+//Unit length pieces of border, keyed by the pixel corner they start at - horizontal run right, vertical run down
+using UnitEdges = QSet<QPair<int, int>>;
+
+}
+
+void TestSelectionMask::info()
+{
+    Random random(1);
+    const QRect area = testArea();
+    for(int i = 0; i < Constants::RandomMaskCount; i++)
+    {
+        const SelectionMask mask = randomMask(random);
+
+        qint64 pixelCount = 0;
+        QRect boundingRect;
+        mask.forEachPixel([&](const int x, const int y)-> void
+        {
+            pixelCount++;
+            boundingRect |= QRect(x, y, 1, 1);
+        });
+        QCOMPARE(mask.pixelCount(), pixelCount);
+        QCOMPARE(mask.boundingRect(), boundingRect);
+        QCOMPARE(mask.isEmpty(), pixelCount == 0);
+
+        //contains matches the spans
+        QSet<QPair<int, int>> pixels;
+        mask.forEachPixel([&](const int x, const int y)-> void
+        {
+            pixels.insert(qMakePair(x, y));
+        });
+        for(int y = area.top(); y <= area.bottom(); y++)
+        {
+            for(int x = area.left(); x <= area.right(); x++)
+            {
+                const bool same = mask.contains(x, y) == pixels.contains(qMakePair(x, y));
+                QVERIFY2(same, same ? "" : qPrintable("contains differs at " + pixelText(x, y)));
+            }
+        }
+    }
+}
+
+void TestSelectionMask::translated()
+{
+    Random random(2);
+    const QRect area = testArea();
+    for(int i = 0; i < Constants::RandomMaskCount; i++)
+    {
+        const SelectionMask mask = randomMask(random);
+        const int dx = random.next(11) - 5;
+        const int dy = random.next(11) - 5;
+        const SelectionMask moved = mask.translated(dx, dy);
+
+        QCOMPARE(moved.pixelCount(), mask.pixelCount());
+        QCOMPARE(moved.boundingRect(), mask.isEmpty() ? QRect() : mask.boundingRect().translated(dx, dy));
+        for(int y = area.top(); y <= area.bottom(); y++)
+        {
+            for(int x = area.left(); x <= area.right(); x++)
+            {
+                const bool same = moved.contains(x + dx, y + dy) == mask.contains(x, y);
+                QVERIFY2(same, same ? "" : qPrintable(QString("translated(%1, %2) differs at ").arg(dx).arg(dy) + pixelText(x, y)));
+            }
+        }
+    }
+}
+
+void TestSelectionMask::united()
+{
+    Random random(3);
+    const QRect area = testArea();
+    for(int i = 0; i < Constants::RandomMaskCount; i++)
+    {
+        const SelectionMask a = randomMask(random);
+        const SelectionMask b = i % 10 == 0 ? SelectionMask() : randomMask(random);
+        const SelectionMask result = a.united(b);
+
+        qint64 pixelCount = 0;
+        for(int y = area.top(); y <= area.bottom(); y++)
+        {
+            for(int x = area.left(); x <= area.right(); x++)
+            {
+                const bool expected = a.contains(x, y) || b.contains(x, y);
+                pixelCount += expected ? 1 : 0;
+                const bool same = result.contains(x, y) == expected;
+                QVERIFY2(same, same ? "" : qPrintable("united differs at " + pixelText(x, y)));
+            }
+        }
+        QCOMPARE(result.pixelCount(), pixelCount);
+    }
+}
+
+void TestSelectionMask::intersected()
+{
+    Random random(4);
+    const QRect area = testArea();
+    for(int i = 0; i < Constants::RandomMaskCount; i++)
+    {
+        const SelectionMask a = randomMask(random);
+        const SelectionMask b = i % 10 == 0 ? SelectionMask() : randomMask(random);
+        const SelectionMask result = a.intersected(b);
+
+        qint64 pixelCount = 0;
+        for(int y = area.top(); y <= area.bottom(); y++)
+        {
+            for(int x = area.left(); x <= area.right(); x++)
+            {
+                const bool expected = a.contains(x, y) && b.contains(x, y);
+                pixelCount += expected ? 1 : 0;
+                const bool same = result.contains(x, y) == expected;
+                QVERIFY2(same, same ? "" : qPrintable("intersected differs at " + pixelText(x, y)));
+            }
+        }
+        QCOMPARE(result.pixelCount(), pixelCount);
+    }
+}
+
+//The outline must cover exactly the unit edges between a selected & an unselected pixel, each once, with lines that
+//  are maximal (no two lines on the same row/column meet end to end)
+void TestSelectionMask::outlinePath()
+{
+    Random random(5);
+    const QRect area = testArea();
+    for(int i = 0; i < Constants::RandomMaskCount; i++)
+    {
+        const SelectionMask mask = randomMask(random);
+        const QPainterPath path = mask.outlinePath();
+
+        UnitEdges expectedHorizontal;
+        UnitEdges expectedVertical;
+        for(int y = area.top(); y <= area.bottom(); y++)
+        {
+            for(int x = area.left(); x <= area.right(); x++)
+            {
+                if(mask.contains(x, y - 1) != mask.contains(x, y))
+                {
+                    expectedHorizontal.insert(qMakePair(x, y));
+                }
+                if(mask.contains(x - 1, y) != mask.contains(x, y))
+                {
+                    expectedVertical.insert(qMakePair(x, y));
+                }
+            }
+        }
+
+        UnitEdges horizontal;
+        UnitEdges vertical;
+        QSet<QPair<int, int>> horizontalEnds;//Left & right end of each horizontal line, + its y
+        QSet<QPair<int, int>> verticalEnds;
+        QVERIFY(path.elementCount() % 2 == 0);
+        for(int element = 0; element < path.elementCount(); element += 2)
+        {
+            const QPainterPath::Element from = path.elementAt(element);
+            const QPainterPath::Element to = path.elementAt(element + 1);
+            QVERIFY(from.isMoveTo());
+            QVERIFY(to.isLineTo());
+
+            const int fromX = qRound(from.x);
+            const int fromY = qRound(from.y);
+            const int toX = qRound(to.x);
+            const int toY = qRound(to.y);
+            QVERIFY2(fromY == toY || fromX == toX, qPrintable("Diagonal line from " + pixelText(fromX, fromY)));
+            QVERIFY2(fromX < toX || fromY < toY, qPrintable("Empty or backwards line from " + pixelText(fromX, fromY)));
+
+            UnitEdges& edges = fromY == toY ? horizontal : vertical;
+            for(int x = fromX, y = fromY; x < toX || y < toY; fromY == toY ? x++ : y++)
+            {
+                QVERIFY2(!edges.contains(qMakePair(x, y)), qPrintable("Border drawn twice at " + pixelText(x, y)));
+                edges.insert(qMakePair(x, y));
+            }
+
+            //A line starting where another on the same row/column ends should have been one line
+            QSet<QPair<int, int>>& ends = fromY == toY ? horizontalEnds : verticalEnds;
+            const QPair<int, int> fromEnd = fromY == toY ? qMakePair(fromX, fromY) : qMakePair(fromY, fromX);
+            const QPair<int, int> toEnd = fromY == toY ? qMakePair(toX, toY) : qMakePair(toY, toX);
+            QVERIFY2(!ends.contains(fromEnd) && !ends.contains(toEnd), qPrintable("Line not maximal at " + pixelText(fromX, fromY)));
+            ends.insert(fromEnd);
+            ends.insert(toEnd);
+        }
+
+        QCOMPARE(horizontal, expectedHorizontal);
+        QCOMPARE(vertical, expectedVertical);
+    }
+}
+
+QTEST_GUILESS_MAIN(TestSelectionMask)
+
+#include "tst_selectionmask.moc"
@@ -0,0 +1,16 @@
+QT       += core gui testlib
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TEMPLATE = app
+TARGET = tst_selectionmask
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    tst_selectionmask.cpp \
+    ../../selectionmask.cpp
+
+HEADERS += \
+    ../../selectionmask.h
@@ -0,0 +1,291 @@
+#include "tiledimage.h"
+
+#include <QHash>
+#include <QDebug>
+#include <QtConcurrent>
+#include <cstring>
+#include <numeric>
+
+namespace Constants
+{
+//Speed over size - tiles are compressed every time history is recorded
+const int TileCompressionLevel = 1;
+
+//Size over speed - files are only written on save
+const int FileTileCompressionLevel = 6;
+}
+
+TiledImage::TiledImage()
+{
+}
+
+//Two chained 32 bit hashes (different seeds) of a tile's packed pixels. Only narrows down which tiles might be
+//  unchanged - the two hashes arent independent (both are crc32 where SSE4.2 is available), so matches are confirmed
+//  by comparing the pixels.
+quint64 hashTile(const QByteArray& pixels, const int& rowBytes)
+{
+    uint lowHash = 0;
+    uint highHash = 0x9e3779b9;
+    for(int offset = 0; offset < pixels.size(); offset += rowBytes)
+    {
+        const char* row = pixels.constData() + offset;
+        lowHash = uint(qHashBits(row, size_t(rowBytes), lowHash));
+        highHash = uint(qHashBits(row, size_t(rowBytes), highHash));
+    }
+    return (quint64(highHash) << 32) | lowHash;
+}
+
+//Neighbouring pixels are usually close, so their differences compress a lot better than the pixels themselves
+void predictRows(QByteArray& pixels, const int& rowBytes)
+{
+    uchar* bytes = reinterpret_cast<uchar*>(pixels.data());
+    for(int offset = 0; offset < pixels.size(); offset += rowBytes)
+    {
+        uchar* row = bytes + offset;
+        for(int i = rowBytes - 1; i >= int(sizeof(QRgb)); i--)
+        {
+            row[i] -= row[i - sizeof(QRgb)];
+        }
+    }
+}
+
+void unpredictRows(QByteArray& pixels, const int& rowBytes)
+{
+    uchar* bytes = reinterpret_cast<uchar*>(pixels.data());
+    for(int offset = 0; offset < pixels.size(); offset += rowBytes)
+    {
+        uchar* row = bytes + offset;
+        for(int i = sizeof(QRgb); i < rowBytes; i++)
+        {
+            row[i] += row[i - sizeof(QRgb)];
+        }
+    }
+}
+
+//Packed ARGB32 pixels of a tile covering rect, or empty if it doesnt uncompress to that size
+QByteArray tilePixels(const TiledImage::Tile& tile, const QRect& rect)
+{
+    const int rowBytes = rect.width() * int(sizeof(QRgb));
+    QByteArray pixels = qUncompress(tile.m_compressedPixels);
+    if(pixels.size() != rowBytes * rect.height())
+    {
+        return QByteArray();
+    }
+
+    if(tile.m_predicted)
+    {
+        unpredictRows(pixels, rowBytes);
+    }
+    return pixels;
+}
+
+TiledImage::Tile TiledImage::makeTile(const QImage& argbImage, const QRect& rect, const Tile* pPrevious)
+{
+    Tile tile;
+    const int rowBytes = rect.width() * int(sizeof(QRgb));
+    QByteArray pixels(rowBytes * rect.height(), Qt::Uninitialized);
+    for(int y = 0; y < rect.height(); y++)
+    {
+        std::memcpy(pixels.data() + y * rowBytes, argbImage.constScanLine(rect.top() + y) + rect.left() * sizeof(QRgb), size_t(rowBytes));
+    }
+    tile.m_hash = hashTile(pixels, rowBytes);
+
+    //Only share once the pixels are known to be the same, a hash match alone could be a collision
+    if(pPrevious && pPrevious->m_hash == tile.m_hash)
+    {
+        const QByteArray previousPixels = tilePixels(*pPrevious, rect);
+        if(previousPixels.size() == pixels.size() && std::memcmp(previousPixels.constData(), pixels.constData(), size_t(pixels.size())) == 0)
+        {
+            tile.m_compressedPixels = pPrevious->m_compressedPixels;
+            return tile;
+        }
+    }
+
+    tile.m_compressedPixels = qCompress(pixels, Constants::TileCompressionLevel);
+    return tile;
+}
+
+TiledImage TiledImage::fromImage(const QImage& image, const TiledImage& previous)
+{
+    TiledImage tiledImage;
+    if(image.isNull())
+    {
+        return tiledImage;
+    }
+
+    //Tiles are always Format_ARGB32 (what the canvas works in), so they can be joined with memcpy
+    const QImage argbImage = image.format() == QImage::Format_ARGB32 ? image : image.convertToFormat(QImage::Format_ARGB32);
+
+    tiledImage.m_width = argbImage.width();
+    tiledImage.m_height = argbImage.height();
+    tiledImage.m_tilesWide = (argbImage.width() + TileSize - 1) / TileSize;
+    const int tilesHigh = (argbImage.height() + TileSize - 1) / TileSize;
+
+    //Tiles can only be matched up if the images are the same size
+    const bool canShare = previous.m_width == tiledImage.m_width && previous.m_height == tiledImage.m_height;
+
+    tiledImage.m_tiles.resize(tiledImage.m_tilesWide * tilesHigh);
+    Tile* tiles = tiledImage.m_tiles.data();//Detach before going across threads
+
+    QVector<int> tileIndexes(tiledImage.m_tiles.size());
+    std::iota(tileIndexes.begin(), tileIndexes.end(), 0);
+    QtConcurrent::blockingMap(tileIndexes, [&](const int& i)-> void
+    {
+        tiles[i] = makeTile(argbImage, tiledImage.tileRect(i), canShare ? &previous.m_tiles[i] : nullptr);
+    });
+
+    return tiledImage;
+}
+
+TiledImage TiledImage::fromImage(const QImage& image, const TiledImage& previous, const QRect& changedRect)
+{
+    if(image.isNull() || previous.m_width != image.width() || previous.m_height != image.height())
+    {
+        return fromImage(image, previous);
+    }
+
+    const QImage argbImage = image.format() == QImage::Format_ARGB32 ? image : image.convertToFormat(QImage::Format_ARGB32);
+
+    //Tiles outside changedRect are previous's, only the ones it touches are looked at
+    TiledImage tiledImage = previous;
+    const QRect rect = changedRect.intersected(argbImage.rect());
+    if(rect.isEmpty())
+    {
+        return tiledImage;
+    }
+
+    QVector<int> tileIndexes;
+    for(int tileY = rect.top() / TileSize; tileY <= rect.bottom() / TileSize; tileY++)
+    {
+        for(int tileX = rect.left() / TileSize; tileX <= rect.right() / TileSize; tileX++)
+        {
+            tileIndexes.push_back(tileY * tiledImage.m_tilesWide + tileX);
+        }
+    }
+
+    Tile* tiles = tiledImage.m_tiles.data();//Detach before going across threads
+    QtConcurrent::blockingMap(tileIndexes, [&](const int& i)-> void
+    {
+        tiles[i] = makeTile(argbImage, tiledImage.tileRect(i), &previous.m_tiles[i]);
+    });
+
+    return tiledImage;
+}
+
+TiledImage TiledImage::fromTiles(const int& width, const int& height, const QVector<Tile>& tiles)
+{
+    TiledImage tiledImage;
+    if(width <= 0 || height <= 0)
+    {
+        return tiledImage;
+    }
+
+    const int tilesWide = (width + TileSize - 1) / TileSize;
+    const int tilesHigh = (height + TileSize - 1) / TileSize;
+    if(tiles.size() != tilesWide * tilesHigh)
+    {
+        qDebug() << "TiledImage::fromTiles - Expected " << tilesWide * tilesHigh << " tiles, got " << tiles.size();
+        return tiledImage;
+    }
+
+    tiledImage.m_width = width;
+    tiledImage.m_height = height;
+    tiledImage.m_tilesWide = tilesWide;
+    tiledImage.m_tiles = tiles;
+
+    return tiledImage;
+}
+
+QImage TiledImage::toImage() const
+{
+    if(isNull())
+    {
+        return QImage();
+    }
+
+    QImage image = QImage(QSize(m_width, m_height), QImage::Format_ARGB32);
+    uchar* bits = image.bits();//Detach before going across threads
+    const qsizetype bytesPerLine = image.bytesPerLine();
+
+    QVector<int> tileIndexes(m_tiles.size());
+    std::iota(tileIndexes.begin(), tileIndexes.end(), 0);
+    QtConcurrent::blockingMap(tileIndexes, [&](const int& i)-> void
+    {
+        const QRect rect = tileRect(i);
+        const QByteArray pixels = tilePixels(m_tiles[i], rect);
+        const int rowBytes = rect.width() * int(sizeof(QRgb));
+        if(pixels.isEmpty())
+        {
+            //Tiles from files are only checked here, when first decoded - a bad one is left transparent
+            qDebug() << "TiledImage::toImage - Failed to uncompress tile " << i;
+            for(int y = 0; y < rect.height(); y++)
+            {
+                std::memset(bits + (rect.top() + y) * bytesPerLine + rect.left() * sizeof(QRgb), 0, size_t(rowBytes));
+            }
+            return;
+        }
+
+        for(int y = 0; y < rect.height(); y++)
+        {
+            std::memcpy(bits + (rect.top() + y) * bytesPerLine + rect.left() * sizeof(QRgb), pixels.constData() + y * rowBytes, size_t(rowBytes));
+        }
+    });
+    return image;
+}
+
+TiledImage TiledImage::toFileTiles() const
+{
+    TiledImage fileTiles = *this;
+    Tile* tiles = fileTiles.m_tiles.data();//Detach before going across threads
+
+    QVector<int> tileIndexes(m_tiles.size());
+    std::iota(tileIndexes.begin(), tileIndexes.end(), 0);
+    QtConcurrent::blockingMap(tileIndexes, [&](const int& i)-> void
+    {
+        if(tiles[i].m_predicted)
+        {
+            return;
+        }
+
+        //Tiles that dont uncompress are written as they are, toImage deals with them when the file is loaded
+        const QRect rect = tileRect(i);
+        QByteArray pixels = tilePixels(tiles[i], rect);
+        if(pixels.isEmpty())
+        {
+            return;
+        }
+
+        predictRows(pixels, rect.width() * int(sizeof(QRgb)));
+        tiles[i].m_compressedPixels = qCompress(pixels, Constants::FileTileCompressionLevel);
+        tiles[i].m_predicted = true;
+    });
+
+    return fileTiles;
+}
+
+bool TiledImage::isNull() const
+{
+    return m_tiles.isEmpty();
+}
+
+int TiledImage::width() const
+{
+    return m_width;
+}
+
+int TiledImage::height() const
+{
+    return m_height;
+}
+
+const QVector<TiledImage::Tile>& TiledImage::tiles() const
+{
+    return m_tiles;
+}
+
+QRect TiledImage::tileRect(const int& tileIndex) const
+{
+    const int x = (tileIndex % m_tilesWide) * TileSize;
+    const int y = (tileIndex / m_tilesWide) * TileSize;
+    return QRect(x, y, x + TileSize <= m_width ? TileSize : m_width - x, y + TileSize <= m_height ? TileSize : m_height - y);
+}
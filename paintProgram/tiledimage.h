@@ -0,0 +1,64 @@
+#ifndef TILEDIMAGE_H
+#define TILEDIMAGE_H
+
+#include <QImage>
+#include <QVector>
+#include <QByteArray>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// TiledImage
+///
+///Image stored as TileSize x TileSize tiles (row major) of zlib compressed ARGB32 pixels. Tile data is an implicitly
+///  shared QByteArray, so copies of a TiledImage share every tile and a TiledImage made from an edited image keeps
+///  sharing (and only stores once) the tiles that werent touched.
+class TiledImage
+{
+public:
+    static const int TileSize = 128;
+
+    struct Tile
+    {
+        QByteArray m_compressedPixels;
+        quint64 m_hash = 0;//Of the uncompressed pixels, to find tiles that might be unchanged
+        bool m_predicted = false;//Each byte stored as its difference from the same channel of the pixel to its left (file tiles)
+    };
+
+    TiledImage();
+
+    //Splits image into tiles. Tiles identical to the same tile in previous are shared with previous instead of stored again.
+    static TiledImage fromImage(const QImage& image, const TiledImage& previous = TiledImage());
+
+    //Same as fromImage, for image only changed inside changedRect since previous was made from it. Tiles outside
+    //  changedRect are shared from previous without looking at their pixels.
+    static TiledImage fromImage(const QImage& image, const TiledImage& previous, const QRect& changedRect);
+
+    //Rebuilds a TiledImage from tiles() of one the same size (eg. read back from a file) without decompressing them.
+    //  Null if the tile count doesnt fit. Hashes are kept as they are - fromImage checks the pixels of any tile it
+    //  shares, so a wrong hash only loses sharing.
+    static TiledImage fromTiles(const int& width, const int& height, const QVector<Tile>& tiles);
+
+    //Tiles recompressed to be written to a file - predicted & at a higher level than the (fast to make) history tiles.
+    //  Tiles that already are stay shared.
+    TiledImage toFileTiles() const;
+
+    //Joins tiles back into one (unshared) Format_ARGB32 image. Tiles that dont uncompress to their size are transparent.
+    QImage toImage() const;
+
+    bool isNull() const;
+    int width() const;
+    int height() const;
+    const QVector<Tile>& tiles() const;
+
+private:
+    QRect tileRect(const int& tileIndex) const;
+
+    //rect of argbImage as a tile, sharing pPrevious's data if the pixels are the same
+    static Tile makeTile(const QImage& argbImage, const QRect& rect, const Tile* pPrevious);
+
+    int m_width = 0;
+    int m_height = 0;
+    int m_tilesWide = 0;
+    QVector<Tile> m_tiles;
+};
+
+#endif // TILEDIMAGE_H